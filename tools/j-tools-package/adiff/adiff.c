@@ -5,6 +5,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <unistd.h>
+#include <setjmp.h>
 
 #include "adiff.h"
 
@@ -14,122 +16,230 @@ int flag_find_full_function;
 
 int flag_nested_comments;
 
-char error_message[1024];
+__thread char error_message[1024];
 
 int number_of_choices_limit = 1000;
 
+int number_of_threads = 1;
+
+char * cache_dir = NULL;
+
+__thread FILE * output;
+
+__thread jmp_buf * recovery;
+
+FILE * records = NULL;
+
+__thread char * record_file;
+
+/* the functions of both files, kept from one pair to the next one */
+static __thread arena pair;
+
+/* fatal errors end the program, unless the caller has set 'recovery' */
+void fatal_error(void)
+{
+  if (recovery != NULL)
+    longjmp(*recovery, 1);
+
+  exit(-1);
+}
+
+/* what compare_functions holds outside of the arena 'pair', kept here
+   rather than in its frame so that it can be released when a fatal 
+   error stops the comparison; a field is 0 while it holds nothing */
+typedef struct
+{
+  char * buffer1, * buffer2, * copy1, * copy2;
+  int n1, n2, mapped1, mapped2;
+  source source1, source2, outside1, outside2;
+} pair_files;
+
+static __thread pair_files files;
+
+static void release_buffer(char * buffer, int n, int mapped)
+{
+  if (buffer == NULL)
+    return;
+  if (mapped)
+    unmap_file(buffer, n);
+  else
+    Free(buffer);
+}
+
+static void release_pair_files(void)
+{
+  free_source(&files.source1);
+  free_source(&files.source2);
+  free_source(&files.outside1);
+  free_source(&files.outside2);
+  if (files.copy1 != NULL)
+    Free(files.copy1);
+  if (files.copy2 != NULL)
+    Free(files.copy2);
+  release_buffer(files.buffer1, files.n1, files.mapped1);
+  release_buffer(files.buffer2, files.n2, files.mapped2);
+  memset(&files, 0, sizeof(pair_files));
+}
+
 void compare_functions(char * src1, char * src2)
 {
-  FILE * f;
-  struct stat filestat;
-  int n1, n2;
-  char * buffer1, * buffer2, * buffer1_, * buffer2_;
   fentries functions1, functions2, other1, other2;
   items fitems1, fitems2;
+  run_stats before, file_stats;
+  stats_phase previous;
+  jmp_buf env, * saved;
 
-  finit(&functions1, 10);
-  finit(&functions2, 10);
-
-  f = fopen(src1, "rt");
+  previous = stats_switch(PHASE_LOAD);
+  before = stats;
+  STATS_ADD(COUNT_FILES, 1);
 
-  if (f == NULL)
-    {
-      printf("File %s is missing\n", src1);
-      buffer1 = Malloc(10 * sizeof(char));
-      n1 = 0;
-    }
+  if (pair.first == NULL)
+    arena_init(&pair, 64 * 1024);
   else
+    arena_reset(&pair);
+  record_file = src1;
+
+  /* the files are released before the error goes on to the caller */
+  saved = recovery;
+  recovery = &env;
+  if (setjmp(env) != 0)
     {
-      stat(src1, &filestat);
-      n1 = filestat.st_size;
-      buffer1 = Malloc((n1 + 10) * sizeof(char));
-      assert(fread(buffer1, 1, n1, f) == n1);
-      fclose(f);
+      release_pair_files();
+      recovery = saved;
+      fatal_error();
     }
 
-  buffer1[n1] = 0;
+  finit_in(&functions1, 100, &pair);
+  finit_in(&functions2, 100, &pair);
 
-  f = fopen(src2, "rt");
+  files.buffer1 = map_file(src1, &files.n1);
 
-  if (f == NULL)
+  if (files.buffer1 == NULL)
     {
-      printf("File %s is missing\n", src2);
-      buffer2 = Malloc(10 * sizeof(char));
-      n2 = 0;
+      if (records != NULL)
+	print_record(src1, src1, "missing", 0, 0);
+      else
+	fprintf(output, "File %s is missing\n", src1);
+      files.buffer1 = Malloc(10 * sizeof(char));
+      files.buffer1[0] = 0;
+      files.n1 = 0;
     }
   else
+    files.mapped1 = 1;
+
+  files.buffer2 = map_file(src2, &files.n2);
+
+  if (files.buffer2 == NULL)
     {
-      stat(src2, &filestat);
-      n2 = filestat.st_size;
-      buffer2 = Malloc((n2 + 10) * sizeof(char));
-      assert(fread(buffer2, 1, n2, f) == n2);
-      fclose(f);
-    }    
+      if (records != NULL)
+	print_record(src1, src2, "missing", 0, 0);
+      else
+	fprintf(output, "File %s is missing\n", src2);
+      files.buffer2 = Malloc(10 * sizeof(char));
+      files.buffer2[0] = 0;
+      files.n2 = 0;
+    }
+  else
+    files.mapped2 = 1;
+
+  init_source(&files.source1, files.buffer1, files.n1);
+  init_source(&files.source2, files.buffer2, files.n2);
 
-  buffer2[n2] = 0;
+  stats_switch(PHASE_OTHER);
 
   if (DEBUG_EXTRACTING)
-    printf("Searching for functions in the first file\n");
-  find_functions(buffer1, &functions1);
+    fprintf(output, "Searching for functions in the first file\n");
+  find_functions(&files.source1, &functions1);
   if (DEBUG_EXTRACTING)
-    printf("Searching for functions in the second file\n");
-  find_functions(buffer2, &functions2);
+    fprintf(output, "Searching for functions in the second file\n");
+  find_functions(&files.source2, &functions2);
 
   if (DEBUG_FUNCS)
     {
-      printf("Printing functions in the first file\n");
-      print_functions(buffer1, &functions1);
+      fprintf(output, "Printing functions in the first file\n");
+      print_functions(&files.source1, &functions1);
     }
   if (DEBUG_FUNCS)
     {
-      printf("Printing functions in the second file\n");
-      print_functions(buffer2, &functions2);
+      fprintf(output, "Printing functions in the second file\n");
+      print_functions(&files.source2, &functions2);
     }
 
-  diff_functions(buffer1, buffer2, &functions1, &functions2);
+  stats_switch(PHASE_LOAD);
+  load_function_hashes(&files.source1, &functions1);
+  load_function_hashes(&files.source2, &functions2);
+
+  stats_switch(PHASE_DIFF);
+  diff_functions(&files.source1, &files.source2, &functions1, &functions2);
 
-  finit(&other1, 10);
-  finit(&other2, 10);
+  stats_switch(PHASE_REPORT);
+  save_function_hashes(&files.source1, &functions1);
+  save_function_hashes(&files.source2, &functions2);
 
-  buffer1_ = strdup(buffer1);
-  assert(buffer1_ != NULL);
+  stats_switch(PHASE_DIFF);
 
-  buffer2_ = strdup(buffer2);
-  assert(buffer2_ != NULL);
+  finit_in(&other1, 10, &pair);
+  finit_in(&other2, 10, &pair);
 
-  fadd(&other1, "#DATA DECLARATIONS OUTSIDE OF FUNCTIONS#", 0, n1);
-  fadd(&other2, "#DATA DECLARATIONS OUTSIDE OF FUNCTIONS#", 0, n2);
+  files.copy1 = strdup(files.buffer1);
+  assert(files.copy1 != NULL);
+
+  files.copy2 = strdup(files.buffer2);
+  assert(files.copy2 != NULL);
+
+  fadd(&other1, "#DATA DECLARATIONS OUTSIDE OF FUNCTIONS#", 0, files.n1);
+  fadd(&other2, "#DATA DECLARATIONS OUTSIDE OF FUNCTIONS#", 0, files.n2);
 
   create_items_from_functions(&fitems1, &functions1);
   create_items_from_functions(&fitems2, &functions2);
-  clear(buffer1_, &fitems1);
-  clear(buffer2_, &fitems2);
+  clear(files.copy1, &fitems1);
+  clear(files.copy2, &fitems2);
+
+  init_source(&files.outside1, files.copy1, files.n1);
+  init_source(&files.outside2, files.copy2, files.n2);
 
-  diff_functions(buffer1_, buffer2_, &other1, &other2);
+  load_function_hashes(&files.outside1, &other1);
+  load_function_hashes(&files.outside2, &other2);
+
+  diff_functions(&files.outside1, &files.outside2, &other1, &other2);
+
+  stats_switch(PHASE_REPORT);
+  save_function_hashes(&files.outside1, &other1);
+  save_function_hashes(&files.outside2, &other2);
 
-  Free(buffer1_);
-  Free(buffer2_);
   free_items(&fitems1);
   free_items(&fitems2);
-}
+  release_pair_files();
+  recovery = saved;
 
+  stats_switch(previous);
+  if (flag_stats)
+    {
+      stats_difference(&file_stats, &stats, &before);
+      stats_print(stderr, src1, src2, &file_stats);
+    }
+}
 
-main(int argc, char * * argv)
+/* for the threads which end before the program */
+void free_thread_arenas(void)
 {
-  int i;
+  if (pair.first != NULL)
+    arena_free(&pair);
+  free_choice_arenas();
+}
 
-  if (argc < 3)
-    {
-      printf("%s <input1> <input2> [<-show_all> print all functions] [<-body_only> compare whole functions declaration] [-not_nested disable nested comments] [-vs=<n> is the search space size for pragmas]\n", argv[0]);
-      return 0;
-    }
+void usage(char * name)
+{
+  printf("%s <input1> <input2> [<-show_all> print all functions] [<-body_only> compare whole functions declaration] [-not_nested disable nested comments] [-vs=<n> is the search space size for pragmas] [-threads=<n> number of threads for pragma choices] [-cache=<dir> keep function hashes in <dir>] [-stats time and counters on stderr]\n", name);
+  printf("%s -dir <root 1> <root 2> [<subdir>] <diff file> [options] diff all \".c\" files in the tree, <n> files at a time\n", name);
+  printf("%s -batch [options] diff the pairs \"<input1> <input2>\" read from stdin, one record per function\n", name);
+}
 
-  flag_print_all_funcs = 0;
-  flag_find_full_function = 1;
-  flag_nested_comments = 1;
-  number_of_choices_limit = 500;
+void parse_options(int argc, char * * argv, int first)
+{
+  int i;
 
-  for (i = 3; i < argc; i++)
+  for (i = first; i < argc; i++)
     {
       if (strcmp(argv[i], "-show_all") == 0)
 	{
@@ -152,14 +262,79 @@ main(int argc, char * * argv)
 	  sscanf(argv[i], "-vs=%i", &number_of_choices_limit);
 	  continue;
 	}
+      if (strncmp(argv[i], "-threads=", 9) == 0)
+	{
+	  sscanf(argv[i], "-threads=%i", &number_of_threads);
+	  continue;
+	}
+      if (strncmp(argv[i], "-cache=", 7) == 0)
+	{
+	  cache_dir = argv[i] + 7;
+	  continue;
+	}
+      if (strcmp(argv[i], "-stats") == 0)
+	{
+	  flag_stats = 1;
+	  continue;
+	}
       printf("Invalid argument %s\n", argv[i]);
       exit(-1);
     }
+}
+
+main(int argc, char * * argv)
+{
+  int i;
+
+  output = stdout;
+
+  select_kernels();
 
-  printf("Processing functions in two files started\n");
+  flag_print_all_funcs = 0;
+  flag_find_full_function = 1;
+  flag_nested_comments = 1;
+  number_of_choices_limit = 500;
+  number_of_threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+  if ((argc >= 2) && (strcmp(argv[1], "-dir") == 0))
+    {
+      for (i = 2; (i < argc) && (argv[i][0] != '-'); i++);
+
+      if ((i - 2 != 3) && (i - 2 != 4))
+	{
+	  usage(argv[0]);
+	  return 0;
+	}
+
+      parse_options(argc, argv, i);
+
+      if (i - 2 == 3)
+	diff_directories(argv[2], argv[3], NULL, argv[4]);
+      else
+	diff_directories(argv[2], argv[3], argv[4], argv[5]);
+
+      return 0;
+    }
+
+  if ((argc >= 2) && (strcmp(argv[1], "-batch") == 0))
+    {
+      parse_options(argc, argv, 2);
+      diff_batch(stdin);
+
+      return 0;
+    }
+
+  if (argc < 3)
+    {
+      usage(argv[0]);
+      return 0;
+    }
+
+  parse_options(argc, argv, 3);
+
+  fprintf(output, "Processing functions in two files started\n");
   compare_functions(argv[1], argv[2]);
-  printf("Processing functions in two files finished\n");
+  fprintf(output, "Processing functions in two files finished\n");
 
   return 0;
 }
-
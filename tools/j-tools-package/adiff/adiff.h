@@ -1,6 +1,9 @@
 #ifndef FDIFF
 #define FDIFF
 
+#include <stdio.h>
+#include <setjmp.h>
+
 #define MAX_NAME_LENGTH 10000
 
 #define MIN(x, y) ((x) <= (y) ? (x) : (y))
@@ -12,6 +15,29 @@
 typedef enum {PRAGMA_IF, PRAGMA_ELSE, PRAGMA_ENDIF, PRAGMA_OTHER, 
 	      STRING, LITERAL, COMMENT, OTHER, ESCSEQ} pragma_type;
 
+typedef struct arena_block
+{
+  struct arena_block * next;
+  int size, used;
+  char data[];
+} arena_block;
+
+/* memory which is freed all at once, or down to a mark */
+typedef struct
+{
+  int block_size;
+  arena_block * first, * current;
+  int num_names, names_size;
+  char * * names; /* interned names, see arena_intern */
+} arena;
+
+typedef struct
+{
+  arena_block * block;
+  int used;
+  int num_names;
+} arena_mark;
+
 typedef struct
 {
   int begin, end; 
@@ -23,20 +49,90 @@ typedef struct
   int number_of_items;
   int max_pairs;
   item * data;
+  arena * pool; /* NULL if the data is on the heap */
 } items;
 
+/* offsets of a buffer as intervals, sorted and neither overlapping nor 
+   touching; an interval has the type of the first item it comes from */
+typedef struct
+{
+  int number_of_intervals;
+  int max_intervals;
+  item * data;
+  arena * pool; /* NULL if the data is on the heap */
+} interval_set;
+
+#define ANY_TYPE ((pragma_type) -1)
+
+typedef struct
+{
+  char * data;
+  int length;
+  int num_lines;
+  int * lines; /* offset of the first character of each line */
+  char * cleaned; /* comments and literals are cleared, NULL until clean_source */
+  int cleaned_length;
+  items literals;
+} source;
+
 typedef struct
 {
   char * fname;
   int fbegin, fend;
+  unsigned long long fhash; /* normalized text, valid if fhashed is set */
+  int fhashed;
 } fentry;
 
 typedef struct
 {
   int num_funcs, max_funcs;
   fentry * data;
+  int hash_size;
+  int * hash; /* name index: position in data plus one, 0 for empty slots */
+  arena * pool; /* NULL if the data is on the heap, names are interned otherwise */
 } fentries;
 
+typedef struct
+{
+  int fbegin, fend;
+  int index;
+} finterval;
+
+/* bracket kinds must stay in this order, see match_brackets */
+typedef enum {TOKEN_IDENTIFIER, 
+	      TOKEN_OPEN_PAREN, TOKEN_CLOSE_PAREN, 
+	      TOKEN_OPEN_SQUARE, TOKEN_CLOSE_SQUARE, 
+	      TOKEN_OPEN_CURLY, TOKEN_CLOSE_CURLY, 
+	      TOKEN_SEMICOLON, TOKEN_COMMA, TOKEN_OTHER} token_kind;
+
+typedef struct
+{
+  int begin, end;
+  token_kind kind;
+  int match; /* matching bracket of the same kind, -1 if none */
+} tentry;
+
+typedef struct
+{
+  int num_tokens, max_tokens;
+  tentry * data;
+  arena * pool; /* NULL if the data is on the heap */
+} tentries;
+
+typedef struct
+{
+  char * file1, * file2;
+  char * text; /* output of the comparison */
+  size_t size;
+  int done;
+} file_pair;
+
+typedef struct
+{
+  int num_pairs, max_pairs;
+  file_pair * data;
+} file_pairs;
+
 typedef enum {AND, OR, TERM} comp_type;
 
 typedef struct element
@@ -46,10 +142,45 @@ typedef struct element
   comp_type type;
   int text_begin, text_end, pragma_begin, pragma_end, pragma_type;
   int pid;
+  int number_of_choices; /* see count_choices */
   struct element * * list;
+  arena * pool; /* NULL if the element is on the heap */
 } element;
 
-typedef struct {int depth, width;} depth_width;
+typedef struct
+{
+  char * buffer; /* comments, literals and pragmas are cleared */
+  int length;
+  element * Pragmas; /* NULL if there are no conditional pragmas */
+  int number_of_choices;
+  arena pool; /* the buffer and the pragmas */
+} preprocessed;
+
+/* phases and counters of "-stats", kept per thread; the time of a 
+   phase does not include the phases it calls */
+typedef enum {PHASE_OTHER, PHASE_LOAD, PHASE_SCAN, PHASE_PRAGMAS, 
+	      PHASE_FUNCTIONS, PHASE_DIFF, PHASE_REPORT, 
+	      NUMBER_OF_PHASES} stats_phase;
+
+typedef enum {COUNT_FILES, COUNT_BYTES, COUNT_TOKENS, 
+	      COUNT_CHOICES, COUNT_CHOICE_SPACE, COUNT_CAPPED, 
+	      COUNT_ALLOCATIONS, COUNT_HASHED, COUNT_CACHED, 
+	      COUNT_SKIPPED, COUNT_COMPARED, 
+	      NUMBER_OF_COUNTERS} stats_counter;
+
+typedef struct
+{
+  double time[NUMBER_OF_PHASES];
+  long long count[NUMBER_OF_COUNTERS];
+  stats_phase phase; /* the phase running since 'start' */
+  double start;
+} run_stats;
+
+extern int flag_stats;
+extern __thread run_stats stats;
+
+#define STATS_ADD(counter, n) \
+  do { if (flag_stats) stats.count[counter] += (n); } while (0)
 
 #define DEBUG_EXTRACTING 0
 #define DEBUG_MATCHING 0
@@ -68,81 +199,145 @@ typedef struct {int depth, width;} depth_width;
 #define INTERNAL_DIFF 1
 #define allow_space_in_pragma_name 1
 
-int get_line_number(char * buffer, int index);
+extern __thread FILE * output;
+extern int (* skip_blanks)(char * buffer, int index, int n);
+extern int (* equal_prefix)(char * buffer1, char * buffer2, int n);
+extern __thread jmp_buf * recovery;
+extern FILE * records;
+extern __thread char * record_file;
+
+void fatal_error(void) __attribute__((noreturn));
+void select_kernels(void);
+void diff_directories(char * root1, char * root2, char * subdir, char * diff_file);
+int is_diffed_file(char * name);
+void find_file_pairs(char * root1, char * root2, char * subdir, file_pairs * pairs);
+void diff_batch(FILE * input);
+int get_line_number(source * src, int index);
+void init_source(source * src, char * data, int length);
+void free_source(source * src);
+char * map_file(char * file, int * length);
+void unmap_file(char * data, int length);
+void clean_source(source * src);
+unsigned long long hash_bytes(unsigned long long h, char * data, int n);
+unsigned long long function_hash(source * src, fentry * function);
+void load_function_hashes(source * src, fentries * functions);
+void save_function_hashes(source * src, fentries * functions);
+int find_item_index(items * Items, int index);
 int is_delimiter(char c);
-int get_token(char * orig_buffer, char * buffer, int n, int index, int * begin, int * end, char * token);
+int get_token(source * src, char * buffer, int n, int index, int * begin, int * end, char * token);
 int is_data_declaration(char * token);
 void invert(char * src, char * dest);
-int get_func_name(char * orig_buffer, char * buffer, int index, char * name);
-int get_next_function(char * orig_buffer, char * buffer, int current,  char * fname, int * fbegin, int * fend, int prev_decl_end);
+int get_func_name(source * src, char * buffer, int index, char * name);
+int get_next_function(source * src, char * buffer, tentries * tokens, int current, char * fname, int * fbegin, int * fend, int prev_decl_end);
 void compare_functions(char * src1, char * src2);
-int find_functions(char * buffer, fentries * functions);
+void free_thread_arenas(void);
+int find_functions(source * src, fentries * functions);
 void add_item(items * Items, int begin, int end, pragma_type type);
-void print_functions(char * orig_buffer, fentries * functions);
+void print_functions(source * src, fentries * functions);
 void save_function(char * file, char * buffer, int begin, int end);
-void diff_functions(char * buffer1, char * buffer2, fentries * functions1, fentries * functions2);
+void diff_functions(source * src1, source * src2, fentries * functions1, fentries * functions2);
+void print_record(char * file, char * function, char * kind, int line1, int line2);
 void finit(fentries * FEntries, int max_funcs);
+void finit_in(fentries * FEntries, int max_funcs, arena * pool);
 void fadd(fentries * FEntries, char * name, int begin, int end);
+int ffind(fentries * FEntries, char * name);
+void ffree(fentries * FEntries);
+unsigned int hash_name(char * name);
+finterval * create_func_intervals(fentries * functions);
 void adjust_items(items * Items, int shift, int begin, int end);
-void removeItems(char * buffer, items * Items);
 void clear(char * buffer, items * Items);
 void insertSpaces(char * buffer, items * Items);
 int match_symbol(char * buffer, int index, char symbol);
 int matchEmptyLines(char * buffer, int index, items * Items);
 int matchSpace(char * buffer, int index, items * Items);
 int matchComment(char * buffer, int index, items * Items);
-void find_comments_and_literals(char * orig_buffer, char * buffer, items * Items, int add_literals, int add_comments, int add_backslashes);
-void find_pragmas(char * orig_buffer, char * buffer, items * Items);
+void find_comments_and_literals(source * src, char * buffer, items * Items, int add_literals, int add_comments, int add_backslashes);
+void find_pragmas(source * src, char * buffer, items * Items);
 void findSpaces(char * buffer, items * Items);
 void findEmptyLines(char * buffer, items * Items);
 void findNeededSpaces(char * buffer, items * Items);
 void init_items(items * Items, int max_items);
+void init_items_in(items * Items, int max_items, arena * pool);
 void free_items(items * Items);
-int diff(char * _buffer1, char * _newbuffer1, int fbegin1, int fend1, items * _literals1, 
-	 char * _buffer2, char * _newbuffer2, int fbegin2, int fend2, items * _literals2,
+void iset_init_in(interval_set * set, int max_intervals, arena * pool);
+void iset_free(interval_set * set);
+void iset_add_items(interval_set * set, items * Items, pragma_type type);
+void iset_clear(char * buffer, interval_set * set);
+int diff(source * src1, int fbegin1, int fend1, 
+	 source * src2, int fbegin2, int fend2, 
 	 int * offset1, int * offset2);
+int external_diff(char * buffer1, int fbegin1, int fend1, 
+		  char * buffer2, int fbegin2, int fend2);
 void create_func_items(items * orig, items * new, int fbegin, int fend);
 int is_space(char c);
 int skip_spaces(char * buffer, int index);
 int compatible_tokens(char * token1, char * token2);
-int get_simple_token(char * orig_buffer, char * buffer, int n, int index, int * begin, int * end, char * token);
-int match_bracket(char * orig_buffer, char * buffer, int n, int index, char * opening, char * closing);
-int find_token(char * orig_buffer, char * buffer, int n, int index, char * target);
+int get_simple_token(source * src, char * buffer, int n, int index, int * begin, int * end, char * token);
+int get_simple_token_limits(char * buffer, int n, int index, int * begin, int * end);
+int get_token_limits(char * buffer, int n, int index, int * begin, int * end, int * second);
+int token_equal(char * buffer, int begin, int end, int second, char * target);
+void tokenize(source * src, char * buffer, tentries * tokens, arena * pool);
+int find_token_index(tentries * tokens, int index);
+void tinit(tentries * TEntries, int max_tokens);
+void tinit_in(tentries * TEntries, int max_tokens, arena * pool);
+void tadd(tentries * TEntries, int begin, int end, token_kind kind);
+void tfree(tentries * TEntries);
+int match_bracket(source * src, char * buffer, int n, int index, char * opening, char * closing);
+int find_token(source * src, char * buffer, int n, int index, char * target);
 int is_identifier(char * token);
 int move_to_BOL(char * buffer, int index);
 int move_to_EOL(char * buffer, int n, int index);
 pragma_type get_pragma_type(char * token);
-int get_line(char * orig_buffer, char * buffer, int n, int index, int * lbegin, int * lend, char * line);
-pragma_type extract_pragma_name(char * line);
+int get_line(source * src, char * buffer, int n, int index, int * lbegin, int * lend, char * line);
+pragma_type extract_pragma_name(source * src, char * line);
 void copy_items_type(items * orig, items * new, pragma_type type);
 void delete_items_type(items * orig, items * new, pragma_type type);
 void * Malloc(int size);
+void * Realloc(void * data, int size);
 void Free(void * data);
-void print_items(char * orig_buffer, items * Items);
+void arena_init(arena * Arena, int block_size);
+void arena_free(arena * Arena);
+void arena_reset(arena * Arena);
+void * arena_alloc(arena * Arena, int size);
+void * arena_grow(arena * Arena, void * data, int old_size, int new_size);
+arena_mark arena_get_mark(arena * Arena);
+void arena_release(arena * Arena, arena_mark mark);
+char * arena_intern(arena * Arena, char * name);
+void * Alloc(arena * pool, int size);
+void * Grow(arena * pool, void * data, int old_size, int new_size);
+void Release(arena * pool, void * data);
+void print_items(source * src, items * Items);
 void parse_pragmas(items * input, element * Pragmas);
 char * types_enum2str(pragma_type x);
-element * parse_OR_pragmas(char * orig_buffer, items * input, int begin, int end, int * _index);
-element * parse_AND_pragmas(char * orig_buffer, items * input, int begin, int end, int * _index);
+element * parse_OR_pragmas(source * src, items * input, int begin, int end, int * _index);
+element * parse_AND_pragmas(source * src, items * input, int begin, int end, int * _index);
+void free_pragmas(element * Element);
 element * create_pragmas(int pid, int tbegin, int tend, int pbegin, 
-			 int pend, comp_type type, int max_elements);
-int find_next_pragma(char * orig_buffer, items * input, int start, int end);
-void print_pragmas(char * orig_buffer, element * Element, int indent);
+			 int pend, comp_type type, int max_elements, arena * pool);
+int find_next_pragma(source * src, items * input, int start, int end);
+void print_pragmas(source * src, element * Element, int indent);
 char * comp_types_enum2str(comp_type x);
-void fill_pdata(char * orig_buffer, items * inputs, element * Pragma);
-void fill_tdata(char * orig_buffer, items * inputs, element * Pragma);
-void select_branch(char * orig_buffer, char * buffer, element * Pragmas, 
-		   items * deleted, int * selectors);
-void select_branch_internal(char * orig_buffer, char * buffer, element * Pragmas, 
-			    items * deleted, int * selectors, int depth);
-depth_width compute_depth_width(element * Pragmas);
-int compute_VS(depth_width dw);
-int find_functions_internal(char * buffer, fentries * functions, 
-			    int choice, int * number_of_choices);
-void create_selectors(depth_width dw, int selector, int * selectors);
+void fill_pdata(source * src, items * inputs, element * Pragma);
+void fill_tdata(source * src, items * inputs, element * Pragma);
+void select_branch(source * src, char * buffer, element * Pragmas, 
+		   items * deleted, int choice, arena * pool);
+void select_branch_internal(source * src, char * buffer, element * Pragmas, 
+			    items * deleted, int choice);
+int count_choices(element * Pragmas);
+void preprocess(source * src, preprocessed * pre);
+void free_preprocessed(preprocessed * pre);
+void free_choice_arenas(void);
+int find_functions_internal(source * src, preprocessed * pre, 
+			    fentries * functions, int choice, arena * scratch);
 void select_best_func_limits(fentries * source, int counter, fentries * destination);
 void create_items_from_functions(items * fitems, fentries * functions);
 int fix_func_overlap(fentries * functions);
 int check_func_overlap(fentries * functions);
+int check_func_duplicates(fentries * functions);
 int between(int x, int min, int max);
+stats_phase stats_switch(stats_phase phase);
+void stats_merge(run_stats * into, run_stats * from, int with_times);
+void stats_difference(run_stats * result, run_stats * after, run_stats * before);
+void stats_print(FILE * f, char * name1, char * name2, run_stats * s);
 
 #endif
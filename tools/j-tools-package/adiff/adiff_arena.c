@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "adiff.h"
+
+/* all allocations are aligned as malloc would do for 'long long' and 'double' */
+#define ARENA_ALIGN(size) (((size) + 15) & ~15)
+
+static arena_block * new_block(int size)
+{
+  arena_block * block;
+
+  block = Malloc(sizeof(arena_block) + size);
+  block->next = NULL;
+  block->size = size;
+  block->used = 0;
+
+  return block;
+}
+
+void arena_init(arena * Arena, int block_size)
+{
+  Arena->block_size = ARENA_ALIGN(block_size);
+  Arena->first = new_block(Arena->block_size);
+  Arena->current = Arena->first;
+
+  Arena->num_names = 0;
+  Arena->names_size = 0;
+  Arena->names = NULL;
+}
+
+void arena_free(arena * Arena)
+{
+  arena_block * block, * next;
+
+  for (block = Arena->first; block != NULL; block = next)
+    {
+      next = block->next;
+      Free(block);
+    }
+  if (Arena->names != NULL)
+    Free(Arena->names);
+
+  Arena->first = NULL;
+  Arena->current = NULL;
+  Arena->names = NULL;
+  Arena->num_names = 0;
+  Arena->names_size = 0;
+}
+
+/* empties the arena but keeps its blocks, which the next allocations reuse */
+void arena_reset(arena * Arena)
+{
+  int i;
+
+  Arena->first->used = 0;
+  Arena->current = Arena->first;
+
+  for (i = 0; i < Arena->names_size; i++)
+    Arena->names[i] = NULL;
+  Arena->num_names = 0;
+}
+
+void * arena_alloc(arena * Arena, int size)
+{
+  arena_block * block, * current;
+  void * p;
+
+  size = ARENA_ALIGN(MAX(size, 1));
+  current = Arena->current;
+
+  if (current->used + size > current->size)
+    {
+      /* blocks left over by arena_release are reused when they are large enough */
+      block = current->next;
+      if ((block == NULL) || (block->size < size))
+	{
+	  block = new_block(MAX(Arena->block_size, size));
+	  block->next = current->next;
+	  current->next = block;
+	}
+      block->used = 0;
+      Arena->current = current = block;
+    }
+
+  p = current->data + current->used;
+  current->used += size;
+
+  return p;
+}
+
+/* the last allocation is extended in place when possible,
+   the old copy is otherwise left in the arena */
+void * arena_grow(arena * Arena, void * data, int old_size, int new_size)
+{
+  arena_block * current;
+  void * p;
+
+  current = Arena->current;
+  old_size = ARENA_ALIGN(MAX(old_size, 1));
+
+  if ((data != NULL) &&
+      ((char *) data + old_size == current->data + current->used) &&
+      (current->used - old_size + ARENA_ALIGN(new_size) <= current->size))
+    {
+      current->used += ARENA_ALIGN(new_size) - old_size;
+      return data;
+    }
+
+  p = arena_alloc(Arena, new_size);
+  if (data != NULL)
+    memcpy(p, data, MIN(old_size, new_size));
+
+  return p;
+}
+
+arena_mark arena_get_mark(arena * Arena)
+{
+  arena_mark mark;
+
+  mark.block = Arena->current;
+  mark.used = Arena->current->used;
+  mark.num_names = Arena->num_names;
+
+  return mark;
+}
+
+/* frees everything allocated after 'mark' at once,
+   names cannot be interned in this part of the arena */
+void arena_release(arena * Arena, arena_mark mark)
+{
+  assert(mark.num_names == Arena->num_names);
+
+  Arena->current = mark.block;
+  Arena->current->used = mark.used;
+}
+
+/* returns the copy of 'name' kept in the arena, the same for equal names */
+char * arena_intern(arena * Arena, char * name)
+{
+  int i, mask, slot, old_size;
+  char * * old_names;
+
+  if (2 * (Arena->num_names + 1) > Arena->names_size)
+    {
+      old_names = Arena->names;
+      old_size = Arena->names_size;
+      Arena->names_size = MAX(2 * old_size, 64);
+      Arena->names = Malloc(Arena->names_size * sizeof(char *));
+      for (i = 0; i < Arena->names_size; i++)
+	Arena->names[i] = NULL;
+      mask = Arena->names_size - 1;
+      for (i = 0; i < old_size; i++)
+	if (old_names[i] != NULL)
+	  {
+	    slot = hash_name(old_names[i]) & mask;
+	    while (Arena->names[slot] != NULL)
+	      slot = (slot + 1) & mask;
+	    Arena->names[slot] = old_names[i];
+	  }
+      if (old_names != NULL)
+	Free(old_names);
+    }
+
+  mask = Arena->names_size - 1;
+  slot = hash_name(name) & mask;
+  while (Arena->names[slot] != NULL)
+    {
+      if (strcmp(Arena->names[slot], name) == 0)
+	return Arena->names[slot];
+      slot = (slot + 1) & mask;
+    }
+
+  Arena->names[slot] = arena_alloc(Arena, strlen(name) + 1);
+  strcpy(Arena->names[slot], name);
+  Arena->num_names++;
+
+  return Arena->names[slot];
+}
+
+/* the storage of items, fentries, tentries and pragmas comes from 'pool'
+   if it is set and from the heap otherwise */
+void * Alloc(arena * pool, int size)
+{
+  if (pool != NULL)
+    return arena_alloc(pool, size);
+
+  return Malloc(size);
+}
+
+void * Grow(arena * pool, void * data, int old_size, int new_size)
+{
+  if (pool != NULL)
+    return arena_grow(pool, data, old_size, new_size);
+
+  return Realloc(data, new_size);
+}
+
+void Release(arena * pool, void * data)
+{
+  if (pool == NULL)
+    Free(data);
+}
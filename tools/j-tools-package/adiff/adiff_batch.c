@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+
+#include "adiff.h"
+
+/* "adiff -batch": the pairs "<input1> <input2>" are read from 'input',
+   one per line, and compared in the same process, so that the threads
+   and the arenas are kept from one pair to the next one.  A function
+   which is changed, added or deleted gives a record on stdout (see
+   print_record), a pair ends with an "end" record or with an "error"
+   record when a fatal error stopped it; messages and warnings go to
+   stderr.  stdout is flushed after every pair, so that the records
+   can be read while the next pair is compared */
+void diff_batch(FILE * input)
+{
+  char * line = NULL, * file1, * file2;
+  size_t size = 0;
+  jmp_buf env;
+  run_stats before, file_stats;
+  int n;
+
+  records = stdout;
+  output = stderr;
+
+  while (getline(&line, &size, input) >= 0)
+    {
+      file1 = Malloc(strlen(line) + 1);
+      file2 = Malloc(strlen(line) + 1);
+      n = sscanf(line, "%s %s", file1, file2);
+
+      if (n == 1)
+	{
+	  fprintf(output, "Invalid pair of files: %s", line);
+	  print_record(file1, "", "error", 0, 0);
+	}
+      else if (n == 2)
+	{
+	  recovery = &env;
+	  before = stats;
+	  if (setjmp(env) == 0)
+	    {
+	      compare_functions(file1, file2);
+	      print_record(file1, "", "end", 0, 0);
+	    }
+	  else
+	    {
+	      print_record(file1, "", "error", 0, 0);
+	      if (flag_stats)
+		{
+		  /* the error skipped the line of compare_functions */
+		  stats_switch(PHASE_OTHER);
+		  stats_difference(&file_stats, &stats, &before);
+		  stats_print(stderr, file1, file2, &file_stats);
+		}
+	    }
+	  recovery = NULL;
+	}
+      fflush(records);
+
+      Free(file1);
+      Free(file2);
+    }
+
+  free(line);
+  records = NULL;
+  output = stdout;
+}
@@ -0,0 +1,147 @@
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "adiff.h"
+
+#define CACHE_VERSION "adiff function hashes 1"
+
+extern int flag_find_full_function;
+
+extern int flag_nested_comments;
+
+extern int number_of_choices_limit;
+
+extern char * cache_dir;
+
+/* the cache is addressed by the contents of the buffer and by the options 
+   which change the functions found in it, so the same version of a file 
+   is normalized once whichever versions it is compared with */
+static char * cache_file_name(source * src)
+{
+  unsigned long long h;
+  char * name;
+  int options[3];
+
+  options[0] = flag_find_full_function;
+  options[1] = flag_nested_comments;
+  options[2] = number_of_choices_limit;
+
+  h = 14695981039346656037ULL;
+  h = hash_bytes(h, CACHE_VERSION, strlen(CACHE_VERSION));
+  h = hash_bytes(h, (char *) options, sizeof(options));
+  h = hash_bytes(h, (char *) &src->length, sizeof(int));
+  h = hash_bytes(h, src->data, src->length);
+
+  name = Malloc(strlen(cache_dir) + 32);
+  sprintf(name, "%s/%016llx", cache_dir, h);
+
+  return name;
+}
+
+/* hashes are used only if the cached functions are exactly the same */
+void load_function_hashes(source * src, fentries * functions)
+{
+  FILE * f;
+  char * name, * line;
+  int i, n, fbegin, fend, length, max_length;
+  unsigned long long * hashes;
+  char version[64];
+
+  if (cache_dir == NULL)
+    return;
+
+  name = cache_file_name(src);
+  f = fopen(name, "r");
+  Free(name);
+  if (f == NULL)
+    return;
+
+  max_length = src->length + 64;
+  line = Malloc(max_length);
+  hashes = Malloc((functions->num_funcs + 1) * sizeof(unsigned long long));
+
+  if ((fgets(version, sizeof(version), f) == NULL) || 
+      (strncmp(version, CACHE_VERSION, strlen(CACHE_VERSION)) != 0) || 
+      (fscanf(f, "%i\n", &n) != 1) || (n != functions->num_funcs))
+    goto done;
+
+  for (i = 0; i < n; i++)
+    {
+      if (fscanf(f, "%i %i %llx ", &fbegin, &fend, &hashes[i]) != 3)
+	goto done;
+      if (fgets(line, max_length, f) == NULL)
+	goto done;
+      length = strlen(line);
+      if ((length > 0) && (line[length - 1] == '\n'))
+	line[length - 1] = 0;
+      if ((fbegin != functions->data[i].fbegin) || 
+	  (fend != functions->data[i].fend) || 
+	  (strcmp(line, functions->data[i].fname) != 0))
+	goto done;
+    }
+
+  for (i = 0; i < n; i++)
+    {
+      functions->data[i].fhash = hashes[i];
+      functions->data[i].fhashed = 1;
+    }
+  STATS_ADD(COUNT_CACHED, n);
+
+ done:
+  fclose(f);
+  Free(line);
+  Free(hashes);
+}
+
+/* the file is written under a temporary name and renamed, so that 
+   concurrent runs never see a partial entry */
+void save_function_hashes(source * src, fentries * functions)
+{
+  FILE * f;
+  char * name, * temp_name;
+  struct stat filestat;
+  int i;
+
+  if (cache_dir == NULL)
+    return;
+
+  name = cache_file_name(src);
+  if (stat(name, &filestat) == 0)
+    {
+      Free(name);
+      return;
+    }
+
+  for (i = 0; i < functions->num_funcs; i++)
+    function_hash(src, &functions->data[i]);
+
+  temp_name = Malloc(strlen(name) + 64);
+  sprintf(temp_name, "%s.%i.%lx", name, (int) getpid(), (unsigned long) pthread_self());
+
+  f = fopen(temp_name, "w");
+  if (f == NULL)
+    {
+      fprintf(output, "WARNING: cannot write cache file %s\n", temp_name);
+      Free(temp_name);
+      Free(name);
+      return;
+    }
+
+  fprintf(f, "%s\n%i\n", CACHE_VERSION, functions->num_funcs);
+  for (i = 0; i < functions->num_funcs; i++)
+    fprintf(f, "%i %i %016llx %s\n", functions->data[i].fbegin, functions->data[i].fend, 
+	    functions->data[i].fhash, functions->data[i].fname);
+
+  if ((fclose(f) != 0) || (rename(temp_name, name) != 0))
+    remove(temp_name);
+
+  Free(temp_name);
+  Free(name);
+}
@@ -10,125 +10,229 @@
 
 extern int flag_print_all_funcs;
 
-char * duplicate_substr(char * buffer, int begin, int end)
+/* literals and the buffer without comments and literals are the same for 
+   all functions of a file, so they are found once, when first needed */
+void clean_source(source * src)
 {
-  char * data;
-  int n, m;
+  items comments;
+  int n;
+  stats_phase previous;
+
+  if (src->cleaned != NULL)
+    return;
+
+  previous = stats_switch(PHASE_SCAN);
+  n = src->length;
+
+  init_items(&comments, n + 10);
+  init_items(&src->literals, n + 10);
+  src->cleaned = strdup(src->data);
+  assert(src->cleaned != NULL);
+  find_comments_and_literals(src, src->cleaned, &src->literals, 1, 0, 0);
+  clear(src->cleaned, &src->literals);
+  find_comments_and_literals(src, src->cleaned, &comments, 0, 1, 0);
+  clear(src->cleaned, &comments);
+  src->cleaned_length = strlen(src->cleaned);
+
+  free_items(&comments);
+  stats_switch(previous);
+}
+
+/* the length of the function text, which ends at the end of the buffer */
+static int function_length(source * src, int begin, int end)
+{
+  if ((begin > src->cleaned_length) || (end > src->cleaned_length) || (begin > end))
+    {
+      fprintf(output, "Invalid subrange\n");
+      fatal_error();
+    }
+
+  return MIN(end + 1, src->cleaned_length) - begin;
+}
+
+/* literals which are completely inside of the function, 
+   as literals never overlap only the last one can end outside */
+static void function_literals(items * literals, int begin, int end, 
+			      int * first, int * last)
+{
+  *first = find_item_index(literals, begin);
+  *last = find_item_index(literals, end + 1);
+  if ((*last > *first) && (literals->data[*last - 1].end > end))
+    (*last)--;
+}
+
+unsigned long long hash_bytes(unsigned long long h, char * data, int n)
+{
+  int i;
+
+  for (i = 0; i < n; i++)
+    h = (h ^ (unsigned char) data[i]) * 1099511628211ULL;
+
+  return h;
+}
+
+/* the hash of everything diff() compares: the literals of the function 
+   and its text without comments, literals and whitespace */
+unsigned long long function_hash(source * src, fentry * function)
+{
+  int i, n, first, last, length, trailing;
+  unsigned long long h;
+  char * buffer;
+
+  if (function->fhashed)
+    return function->fhash;
+
+  clean_source(src);
+  STATS_ADD(COUNT_HASHED, 1);
+
+  n = function_length(src, function->fbegin, function->fend);
+  function_literals(&src->literals, function->fbegin, function->fend, &first, &last);
 
-  n = strlen(buffer);
-  m = end - begin + 1;
+  h = 14695981039346656037ULL;
 
-  if ((begin > n) || (end > n) || (begin > end))
+  length = last - first;
+  h = hash_bytes(h, (char *) &length, sizeof(int));
+  for (i = first; i < last; i++)
     {
-      printf("Invalid subrange\n");
-      exit(-1);
+      length = src->literals.data[i].end - src->literals.data[i].begin + 1;
+      h = hash_bytes(h, (char *) &src->literals.data[i].type, sizeof(pragma_type));
+      h = hash_bytes(h, (char *) &length, sizeof(int));
+      h = hash_bytes(h, src->data + src->literals.data[i].begin, length);
     }
 
-  data = Malloc((m + 10) * sizeof(char));
+  buffer = src->cleaned + function->fbegin;
+  trailing = (n > 0);
+  for (i = 0; i < n; i++)
+    if ((buffer[i] != ' ') && (buffer[i] != '\t') && (buffer[i] != '\n'))
+      {
+	h = (h ^ (unsigned char) buffer[i]) * 1099511628211ULL;
+	trailing = (i < n - 1);
+      }
 
-  strncpy(data, buffer + begin, m);
+  /* diff() also tells apart text which ends with blanks from text 
+     which does not */
+  h = hash_bytes(h, (char *) &trailing, sizeof(int));
 
-  data[m] = 0;
+  function->fhash = h;
+  function->fhashed = 1;
 
-  return data;
+  return h;
 }
 
-int diff(char * _buffer1, char * _newbuffer1, int fbegin1, int fend1, items * _literals1, 
-	 char * _buffer2, char * _newbuffer2, int fbegin2, int fend2, items * _literals2,
+static void check_cleaned_length(source * src1, source * src2)
+{
+  if (((src1->cleaned != NULL) && (src1->length != src1->cleaned_length)) || 
+      ((src2->cleaned != NULL) && (src2->length != src2->cleaned_length)))
+    {
+      fprintf(output, "The size of the original and processed buffers do not match\n");
+      fatal_error();
+    }
+}
+
+int diff(source * src1, int fbegin1, int fend1, 
+	 source * src2, int fbegin2, int fend2, 
 	 int * offset1, int * offset2)
 {
-  int i, j, n1, n2, l1, l2, flag, _n1, _n2, ni1, ni2, ni;
-  char * buffer1, * newbuffer1, * buffer2, * newbuffer2;
-  items literals1, literals2;
+  int i, j, k, n1, n2, l1, l2, first1, first2, last1, last2, ni1, ni2, ni;
+  char * newbuffer1, * newbuffer2;
+  item * literals1, * literals2;
+  char c1, c2;
 
   *offset1 = -1;
   *offset2 = -1;
 
-  buffer1 = duplicate_substr(_buffer1, fbegin1, fend1);
-  newbuffer1 = duplicate_substr(_newbuffer1, fbegin1, fend1);
-  buffer2 = duplicate_substr(_buffer2, fbegin2, fend2);
-  newbuffer2 = duplicate_substr(_newbuffer2, fbegin2, fend2);
+  clean_source(src1);
+  clean_source(src2);
 
-  n1 = strlen(buffer1);
-  n2 = strlen(buffer2);
-  _n1 = strlen(_buffer1);
-  _n2 = strlen(_buffer2);
+  n1 = function_length(src1, fbegin1, fend1);
+  n2 = function_length(src2, fbegin2, fend2);
 
-  if ((n1 != strlen(newbuffer1)) || (n2 != strlen(newbuffer2)) ||
-      (_n1 != strlen(_newbuffer1)) || (_n2 != strlen(_newbuffer2)))
-    {
-      printf("The size of the original and processed buffers do not match\n");
-      exit(-1);
-    }
+  check_cleaned_length(src1, src2);
+
+  newbuffer1 = src1->cleaned + fbegin1;
+  newbuffer2 = src2->cleaned + fbegin2;
+
+  function_literals(&src1->literals, fbegin1, fend1, &first1, &last1);
+  function_literals(&src2->literals, fbegin2, fend2, &first2, &last2);
 
-  create_func_items(_literals1, &literals1, fbegin1, fend1);
-  create_func_items(_literals2, &literals2, fbegin2, fend2);
+  literals1 = src1->literals.data + first1;
+  literals2 = src2->literals.data + first2;
 
-  ni1 = literals1.number_of_items;
-  ni2 = literals2.number_of_items;
+  ni1 = last1 - first1;
+  ni2 = last2 - first2;
 
   ni = MIN(ni1, ni2);
 
   for (i = 0; i < ni; i++)
     {
-      l1 = literals1.data[i].end - literals1.data[i].begin + 1;
-      l2 = literals2.data[i].end - literals2.data[i].begin + 1;
+      l1 = literals1[i].end - literals1[i].begin + 1;
+      l2 = literals2[i].end - literals2[i].begin + 1;
 
-      *offset1 = literals1.data[i].begin;
-      *offset2 = literals2.data[i].begin;
+      *offset1 = literals1[i].begin;
+      *offset2 = literals2[i].begin;
 
       if (l1 != l2)
 	{
 	  if (DEBUG_DIFFING)
-	    printf("Literals %i and %i have different sizes\n", l1, l2);
-	  goto different;
+	    fprintf(output, "Literals %i and %i have different sizes\n", l1, l2);
+	  return 1;
 	}
 
-      if (literals1.data[i].type != literals2.data[i].type)
+      if (literals1[i].type != literals2[i].type)
 	{
 	  if (DEBUG_DIFFING)
-	    printf("Literals are of different types %i and %i\n", 
-		   literals1.data[i].type, literals2.data[i].type);
-	  goto different;
+	    fprintf(output, "Literals are of different types %i and %i\n", 
+		   literals1[i].type, literals2[i].type);
+	  return 1;
 	}
 
-      if (strncmp(_buffer1 + literals1.data[i].begin, _buffer2 + literals2.data[i].begin, l1) != 0)
+      if (strncmp(src1->data + literals1[i].begin, src2->data + literals2[i].begin, l1) != 0)
 	{
 	  if (DEBUG_DIFFING)
-	    printf("Literals %i and %i are different\n", l1, l2);
-	  goto different;
+	    fprintf(output, "Literals %i and %i are different\n", l1, l2);
+	  return 1;
 	}
     }
 
   if (i < ni1)
-    *offset1 = literals1.data[i].begin;
+    *offset1 = literals1[i].begin;
 
   if (i < ni2)
-    *offset2 = literals2.data[i].begin;
+    *offset2 = literals2[i].begin;
 
   if (ni1 != ni2)
     {
       if (DEBUG_DIFFING)
-	printf("The number of literals is different\n");
-      goto different;
+	fprintf(output, "The number of literals is different\n");
+      return 1;
     }
 
   if (DEBUG_DIFFING)
-    printf("Literals were OK\n");
+    fprintf(output, "Literals were OK\n");
 
+  /* the buffers are not terminated at the end of the function; 
+     identical text compares equal whatever it contains, it is skipped while 
+     both sides stay inside the function, so offsets do not change */
   for (i = 0, j = 0; ((i < n1) && (j < n2)); i++, j++)
     {
-      while ((newbuffer1[i] == ' ') || (newbuffer1[i] == '\t') || (newbuffer1[i] == '\n')) i++;
-      while ((newbuffer2[j] == ' ') || (newbuffer2[j] == '\t') || (newbuffer2[j] == '\n')) j++;
+      k = equal_prefix(newbuffer1 + i, newbuffer2 + j, MIN(n1 - i, n2 - j) - 1);
+      i += k;
+      j += k;
 
-      if (newbuffer1[i] != newbuffer2[j])
+      i = skip_blanks(newbuffer1, i, n1);
+      j = skip_blanks(newbuffer2, j, n2);
+
+      c1 = (i < n1) ? (newbuffer1[i]) : (0);
+      c2 = (j < n2) ? (newbuffer2[j]) : (0);
+
+      if (c1 != c2)
 	{
 	  if (DEBUG_DIFFING)
-	    printf("Difference was found between %i and %i lines\n", 
-		   get_line_number(_buffer1, i + fbegin1), get_line_number(_buffer2, j + fbegin2));
+	    fprintf(output, "Difference was found between %i and %i lines\n", 
+		   get_line_number(src1, i + fbegin1), get_line_number(src2, j + fbegin2));
 	  *offset1 = i + fbegin1;
 	  *offset2 = j + fbegin2;
-	  goto different;
+	  return 1;
 	}
     }
 
@@ -136,30 +240,16 @@ int diff(char * _buffer1, char * _newbuffer1, int fbegin1, int fend1, items * _l
     {
       *offset1 = i + fbegin1;
       *offset2 = j + fbegin2;
-      goto different;
+      return 1;
     }
 
-  flag = 0;
-  goto next;
-
- different:
-  flag = 1;
-
- next:
-
-  Free(buffer1);
-  Free(buffer2);
-  Free(newbuffer1);
-  Free(newbuffer2);
-  free_items(&literals1);
-  free_items(&literals2);
-
-  return flag;
+  return 0;
 }
 
-void diff_functions(char * buffer1, char * buffer2, fentries * functions1, fentries * functions2)
+/* legacy comparison of the saved functions by cmp */
+int external_diff(char * buffer1, int fbegin1, int fend1, 
+		  char * buffer2, int fbegin2, int fend2)
 {
-  int i, j, found;
   static char command[1024];
   char * file1 = NULL;
   char * file2 = NULL;
@@ -167,159 +257,163 @@ void diff_functions(char * buffer1, char * buffer2, fentries * functions1, fentr
   char * file4 = NULL;
   struct stat filestat;
   FILE * f;
-  items comments1, comments2, literals1, literals2;
-  char * newbuffer1, * newbuffer2;
-  int n1, n2;
+  int diff_flag;
+
+  file1 = tempnam("/tmp/", "diff_");
+  file2 = tempnam("/tmp/", "diff_");
+  file3 = tempnam("/tmp/", "diff_");
+  file4 = tempnam("/tmp/", "diff_");
+
+  if ((file1 == NULL) || (file2 == NULL) || (file3 == NULL) || (file4 == NULL))
+    {
+      fprintf(output, "Cannot create temporary file[s]\n");
+      fatal_error();
+    }
+
+  if (DEBUG_DIFFING)
+    fprintf(output, "Saving function in the first file\n");
+  save_function(file1, buffer1, fbegin1, fend1);
+  if (DEBUG_DIFFING)
+    fprintf(output, "Saving function in the second file\n");
+  save_function(file2, buffer2, fbegin2, fend2);
+
+  remove(file3);
+
+  f = fopen(file4, "w");
+  assert(f != NULL);
+  fprintf(f, "\n\n\ncmp %s %s >& %s\n", file1, file2, file3);
+  fclose(f);
+      
+  sprintf(command, "csh -f %s", file4);
+  if (DEBUG_DIFFING)
+    fprintf(output, "command = %s\n", command);
+  system(command);
+      
+  if (stat(file3, &filestat))
+    {
+      fprintf(output, "Cannot access file %s\n", file3);
+      fatal_error();
+    }
+      
+  if (filestat.st_size > 0)
+    diff_flag = 1;
+  else
+    diff_flag = 0;
+
+  remove(file1);
+  remove(file2);
+  remove(file3);
+  remove(file4);
+
+  Free(file1);
+  Free(file2);
+  Free(file3);
+  Free(file4);
+
+  return diff_flag;
+}
+
+void diff_functions(source * src1, source * src2, fentries * functions1, fentries * functions2)
+{
+  int i, j;
   int diff_flag;
   int offset1, offset2;
+  unsigned long long hash1, hash2;
 
   for (i = 0; i < functions1->num_funcs; i++)
     {
-      found = 0;
-      for (j = 0; j < functions2->num_funcs; j++)
-	if (strcmp(functions1->data[i].fname, functions2->data[j].fname) == 0)
-	  {
-	    found = 1;
-	    break;
-	  }
-
-      if (found)
+      j = ffind(functions2, functions1->data[i].fname);
+
+      if (j >= 0)
 	{
 	  if (DEBUG_EXTRACTING)
-	    printf("Function \"%s\" is found in both files\n", functions1->data[i].fname);
-
-	  file1 = tempnam("/tmp/", "diff_");
-	  file2 = tempnam("/tmp/", "diff_");
-	  file3 = tempnam("/tmp/", "diff_");
-	  file4 = tempnam("/tmp/", "diff_");
-
-	  if ((file1 == NULL) || (file2 == NULL) || (file3 == NULL) || (file4 == NULL))
-	    {
-	      printf("Cannot create temporary file[s]\n");
-	      exit(-1);
-	    }
+	    fprintf(output, "Function \"%s\" is found in both files\n", functions1->data[i].fname);
 
 	  if (DEBUG_DIFFING)
-	    printf("Saving function \"%s\" in the first file\n", functions1->data[i].fname);
-	  save_function(file1, buffer1, functions1->data[i].fbegin, functions1->data[i].fend);
-	  if (DEBUG_DIFFING)
-	    printf("Saving function \"%s\" in the second file\n", functions2->data[j].fname);
-	  save_function(file2, buffer2, functions2->data[j].fbegin, functions2->data[j].fend);
-
-	  if (DEBUG_DIFFING)
-	    printf("Comparing function \"%s\"\n", functions1->data[i].fname);
-
-	  remove(file3);
+	    fprintf(output, "Comparing function \"%s\"\n", functions1->data[i].fname);
 
 	  offset1 = -1;
 	  offset2 = -1;
 
 	  if (INTERNAL_DIFF)
 	    {
-	      n1 = strlen(buffer1);
-	      n2 = strlen(buffer2);
-
-	      init_items(&comments1, n1);
-	      init_items(&literals1, n1);
-	      newbuffer1 = strdup(buffer1);
-	      assert(newbuffer1 != NULL);
-	      find_comments_and_literals(buffer1, newbuffer1, &literals1, 1, 0, 0);
-	      clear(newbuffer1, &literals1);
-	      find_comments_and_literals(buffer1, newbuffer1, &comments1, 0, 1, 0);
-	      clear(newbuffer1, &comments1);
-
-	      init_items(&comments2, n2);
-	      init_items(&literals2, n2);
-	      newbuffer2 = strdup(buffer2);
-	      assert(newbuffer2 != NULL);
-	      find_comments_and_literals(buffer2, newbuffer2, &literals2, 1, 0, 0);
-	      clear(newbuffer2, &literals2);
-	      find_comments_and_literals(buffer2, newbuffer2, &comments2, 0, 1, 0);
-	      clear(newbuffer2, &comments2);
-
-	      diff_flag = diff(buffer1, newbuffer1, 
-			       functions1->data[i].fbegin, functions1->data[i].fend, 
-			       &literals1, 
-			       buffer2, newbuffer2, 
-			       functions2->data[j].fbegin, functions2->data[j].fend, 
-			       &literals2,
-			       &offset1, &offset2);
-
-	      free_items(&comments1);
-	      free_items(&comments2);
-	      free_items(&literals1);
-	      free_items(&literals2);
-	    }
-	  else
-	    {
-	      f = fopen(file4, "w");
-	      assert(f != NULL);
-	      fprintf(f, "\n\n\ncmp %s %s >& %s\n", file1, file2, file3);
-	      fclose(f);
-	      
-	      sprintf(command, "csh -f %s", file4);
-	      if (DEBUG_DIFFING)
-		printf("command = %s\n", command);
-	      system(command);
-	      
-	      if (stat(file3, &filestat))
+	      /* equal hashes mean equal normalized text */
+	      hash1 = function_hash(src1, &functions1->data[i]);
+	      hash2 = function_hash(src2, &functions2->data[j]);
+	      check_cleaned_length(src1, src2);
+
+	      if (hash1 == hash2)
 		{
-		  printf("Cannot access file %s\n", file3);
-		  exit(-1);
+		  STATS_ADD(COUNT_SKIPPED, 1);
+		  diff_flag = 0;
 		}
-	      
-	      if (filestat.st_size > 0)
-		diff_flag = 1;
 	      else
-		diff_flag = 0;
+		{
+		  STATS_ADD(COUNT_COMPARED, 1);
+		  diff_flag = diff(src1, functions1->data[i].fbegin, functions1->data[i].fend, 
+				   src2, functions2->data[j].fbegin, functions2->data[j].fend, 
+				   &offset1, &offset2);
+		}
+	    }
+	  else
+	    {
+	      STATS_ADD(COUNT_COMPARED, 1);
+	      diff_flag = external_diff(src1->data, 
+					functions1->data[i].fbegin, functions1->data[i].fend, 
+					src2->data, 
+					functions2->data[j].fbegin, functions2->data[j].fend);
 	    }
 
-	  if (diff_flag)
+	  if (diff_flag && (records != NULL))
+	    print_record(record_file, functions1->data[i].fname, "changed", 
+			 get_line_number(src1, offset1), 
+			 get_line_number(src2, offset2));
+	  else if (diff_flag)
 	    {   
-	      printf("Function \"%s\" is changed at lines (%i, %i)\n", 
+	      fprintf(output, "Function \"%s\" is changed at lines (%i, %i)\n", 
 		     functions1->data[i].fname, 
-		     get_line_number(buffer1, offset1), 
-		     get_line_number(buffer2, offset2));
+		     get_line_number(src1, offset1), 
+		     get_line_number(src2, offset2));
 	    }
 	  else
 	    {
-	      if (flag_print_all_funcs)
-		printf("Function \"%s\" is the same\n", functions1->data[i].fname);
+	      if (flag_print_all_funcs && (records != NULL))
+		print_record(record_file, functions1->data[i].fname, "same", 
+			     get_line_number(src1, functions1->data[i].fbegin), 
+			     get_line_number(src2, functions2->data[j].fbegin));
+	      else if (flag_print_all_funcs)
+		fprintf(output, "Function \"%s\" is the same\n", functions1->data[i].fname);
 	    }
-
-	  remove(file1);
-	  remove(file2);
-	  remove(file3);
-	  remove(file4);
-
-	  Free(file1);
-	  Free(file2);
-	  Free(file3);
-	  Free(file4);
 	}
+      else if (records != NULL)
+	print_record(record_file, functions1->data[i].fname, "deleted", 
+		     get_line_number(src1, functions1->data[i].fbegin), 0);
       else
-	printf("Function \"%s\" is deleted at line %i\n", 
+	fprintf(output, "Function \"%s\" is deleted at line %i\n", 
 	       functions1->data[i].fname,
-	       get_line_number(buffer1, functions1->data[i].fbegin));
+	       get_line_number(src1, functions1->data[i].fbegin));
     }
 
   for (i = 0; i < functions2->num_funcs; i++)
     {
-      found = 0;
-      for (j = 0; j < functions1->num_funcs; j++)
-	if (strcmp(functions2->data[i].fname, functions1->data[j].fname) == 0)
-	  {
-	    found = 1;
-	    break;
-	  }
-
-      if (! found)
-	printf("Function \"%s\" is added at line %i\n",
+      if (ffind(functions1, functions2->data[i].fname) >= 0)
+	continue;
+      if (records != NULL)
+	print_record(record_file, functions2->data[i].fname, "added", 
+		     0, get_line_number(src2, functions2->data[i].fbegin));
+      else
+	fprintf(output, "Function \"%s\" is added at line %i\n",
 	       functions2->data[i].fname, 
-	       get_line_number(buffer2, functions2->data[i].fbegin));
+	       get_line_number(src2, functions2->data[i].fbegin));
     }
 }
 
+/* "-batch": one line of tab separated fields, 'function' can be empty */
+void print_record(char * file, char * function, char * kind, int line1, int line2)
+{
+  fprintf(records, "%s\t%s\t%s\t%i\t%i\n", file, function, kind, line1, line2);
+}
+
 void save_function(char * file, char * buffer, int begin, int end)
 {
   FILE * f;
@@ -327,18 +421,18 @@ void save_function(char * file, char * buffer, int begin, int end)
   f = fopen(file, "w");
   if (f == NULL)
     {
-      printf("Cannot open file %s for writing\n", file);
-      exit(-1);
+      fprintf(output, "Cannot open file %s for writing\n", file);
+      fatal_error();
     }
 
   if (DEBUG_DIFFING)
-    printf("Saving function from file located in offsets [%i, %i]\n", begin, end);
+    fprintf(output, "Saving function from file located in offsets [%i, %i]\n", begin, end);
 
   fwrite(buffer + begin, 1, end - begin + 1, f);
 
   fclose(f);
 
   if (DEBUG_DIFFING)
-    printf("Function from offsets [%i, %i] was saved in the file %s\n", begin, end, file);
+    fprintf(output, "Function from offsets [%i, %i] was saved in the file %s\n", begin, end, file);
 }
 
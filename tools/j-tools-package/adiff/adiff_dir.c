@@ -0,0 +1,302 @@
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include "adiff.h"
+
+extern int number_of_threads;
+
+/* the "-stats" of all the workers */
+static run_stats total_stats;
+static pthread_mutex_t total_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* file pairs shared by the workers of diff_directories */
+typedef struct
+{
+  file_pairs * pairs;
+  int next_pair;
+  pthread_mutex_t lock;
+  pthread_cond_t finished;
+} file_pool;
+
+/* the same files as adiff_dir.sh compares */
+int is_diffed_file(char * name)
+{
+  if (strstr(name, ".c") == NULL)
+    return 0;
+
+  if (strstr(name, ".int.c") != NULL)
+    return 0;
+
+  return 1;
+}
+
+/* either part of the path can be missing */
+static char * join_path(char * dir, char * name)
+{
+  char * path;
+
+  if (dir == NULL)
+    return strdup(name);
+
+  if (name == NULL)
+    return strdup(dir);
+
+  path = Malloc(strlen(dir) + strlen(name) + 2);
+  sprintf(path, "%s/%s", dir, name);
+
+  return path;
+}
+
+static int compare_names(const void * x, const void * y)
+{
+  return strcmp(* (char * const *) x, * (char * const *) y);
+}
+
+static void add_file_pair(file_pairs * pairs, char * file1, char * file2)
+{
+  file_pair * old_data = NULL;
+  int i;
+
+  if (pairs->num_pairs >= pairs->max_pairs)
+    {
+      pairs->max_pairs = (pairs->max_pairs > 0) ? (2 * pairs->max_pairs) : (100);
+      old_data = pairs->data;
+      pairs->data = Malloc(pairs->max_pairs * sizeof(file_pair));
+      for (i = 0; i < pairs->num_pairs; i++)
+	pairs->data[i] = old_data[i];
+      if (old_data != NULL)
+	Free(old_data);
+    }
+
+  pairs->data[pairs->num_pairs].file1 = file1;
+  pairs->data[pairs->num_pairs].file2 = file2;
+  pairs->data[pairs->num_pairs].text = NULL;
+  pairs->data[pairs->num_pairs].size = 0;
+  pairs->data[pairs->num_pairs].done = 0;
+  pairs->num_pairs++;
+}
+
+/* walks the first tree in the order of "ls", the second tree 
+   only supplies the files with the same names */
+void find_file_pairs(char * root1, char * root2, char * subdir, file_pairs * pairs)
+{
+  DIR * dir;
+  struct dirent * entry;
+  struct stat filestat;
+  char * path, * dir1, * dir2, * subdir_;
+  char * * names;
+  int i, n, max_names;
+
+  dir1 = join_path(root1, subdir);
+  dir2 = join_path(root2, subdir);
+
+  dir = opendir(dir1);
+  if (dir == NULL)
+    {
+      printf("Cannot open directory %s\n", dir1);
+      exit(-1);
+    }
+
+  max_names = 100;
+  names = Malloc(max_names * sizeof(char *));
+  n = 0;
+  while ((entry = readdir(dir)) != NULL)
+    {
+      if (entry->d_name[0] == '.')
+	continue;
+      if (n >= max_names)
+	{
+	  max_names *= 2;
+	  names = realloc(names, max_names * sizeof(char *));
+	  assert(names != NULL);
+	}
+      names[n++] = strdup(entry->d_name);
+    }
+  closedir(dir);
+
+  qsort(names, n, sizeof(char *), compare_names);
+
+  for (i = 0; i < n; i++)
+    {
+      path = join_path(dir1, names[i]);
+
+      if ((stat(path, &filestat) == 0) && (S_ISDIR(filestat.st_mode)))
+	{
+	  subdir_ = join_path(subdir, names[i]);
+	  find_file_pairs(root1, root2, subdir_, pairs);
+	  Free(subdir_);
+	  Free(path);
+	}
+      else if (is_diffed_file(names[i]))
+	add_file_pair(pairs, path, join_path(dir2, names[i]));
+      else
+	Free(path);
+
+      Free(names[i]);
+    }
+
+  Free(names);
+  Free(dir1);
+  Free(dir2);
+}
+
+/* compares the files of one pair into its text; 'pair', 'f' and
+   'before' are set before the setjmp and not changed after it, so
+   they keep their values when fatal_error jumps back */
+static void diff_pair(file_pair * pair)
+{
+  FILE * f;
+  jmp_buf env;
+  run_stats before, file_stats;
+
+  f = open_memstream(&pair->text, &pair->size);
+  assert(f != NULL);
+
+  /* the output, including the error which stopped the comparison, 
+     is the same as the output of a separate adiff run */
+  output = f;
+  recovery = &env;
+  before = stats;
+  if (setjmp(env) == 0)
+    {
+      fprintf(output, "Processing functions in two files started\n");
+      compare_functions(pair->file1, pair->file2);
+      fprintf(output, "Processing functions in two files finished\n");
+    }
+  else if (flag_stats)
+    {
+      /* the error skipped the line of compare_functions */
+      stats_switch(PHASE_OTHER);
+      stats_difference(&file_stats, &stats, &before);
+      stats_print(stderr, pair->file1, pair->file2, &file_stats);
+    }
+  recovery = NULL;
+  output = stdout;
+
+  fclose(f);
+}
+
+static void * file_worker(void * arg)
+{
+  file_pool * pool = arg;
+  file_pair * pair;
+
+  while (1)
+    {
+      pthread_mutex_lock(&pool->lock);
+      pair = (pool->next_pair < pool->pairs->num_pairs) ? 
+	(&pool->pairs->data[pool->next_pair++]) : (NULL);
+      pthread_mutex_unlock(&pool->lock);
+
+      if (pair == NULL)
+	break;
+
+      diff_pair(pair);
+
+      pthread_mutex_lock(&pool->lock);
+      pair->done = 1;
+      pthread_cond_broadcast(&pool->finished);
+      pthread_mutex_unlock(&pool->lock);
+    }
+
+  free_thread_arenas();
+
+  if (flag_stats)
+    {
+      stats_switch(PHASE_OTHER);
+      pthread_mutex_lock(&total_lock);
+      stats_merge(&total_stats, &stats, 1);
+      pthread_mutex_unlock(&total_lock);
+    }
+
+  return NULL;
+}
+
+/* the same as adiff_dir.sh, but the files are compared on a pool 
+   of threads; the results are appended in the order of the files */
+void diff_directories(char * root1, char * root2, char * subdir, char * diff_file)
+{
+  file_pairs pairs;
+  file_pool pool;
+  pthread_t * workers;
+  file_pair * pair;
+  FILE * f;
+  int i, threads;
+  stats_phase previous;
+
+  pairs.num_pairs = 0;
+  pairs.max_pairs = 0;
+  pairs.data = NULL;
+
+  find_file_pairs(root1, root2, subdir, &pairs);
+
+  f = fopen(diff_file, "a");
+  if (f == NULL)
+    {
+      printf("Cannot open file %s for writing\n", diff_file);
+      exit(-1);
+    }
+
+  /* files are compared in parallel, pragma choices of a file are not */
+  threads = MAX(MIN(number_of_threads, pairs.num_pairs), 1);
+  number_of_threads = 1;
+
+  pool.pairs = &pairs;
+  pool.next_pair = 0;
+  pthread_mutex_init(&pool.lock, NULL);
+  pthread_cond_init(&pool.finished, NULL);
+
+  workers = Malloc(threads * sizeof(pthread_t));
+  for (i = 0; i < threads; i++)
+    if (pthread_create(&workers[i], NULL, file_worker, &pool) != 0)
+      {
+	printf("Cannot create thread\n");
+	exit(-1);
+      }
+
+  previous = stats_switch(PHASE_REPORT);
+  for (i = 0; i < pairs.num_pairs; i++)
+    {
+      pair = &pairs.data[i];
+
+      pthread_mutex_lock(&pool.lock);
+      while (! pair->done)
+	pthread_cond_wait(&pool.finished, &pool.lock);
+      pthread_mutex_unlock(&pool.lock);
+
+      printf("Diffing %s and %s\n", pair->file1, pair->file2);
+      fprintf(f, "Comparing files %s and %s\n", pair->file1, pair->file2);
+      fwrite(pair->text, 1, pair->size, f);
+
+      free(pair->text);
+      Free(pair->file1);
+      Free(pair->file2);
+    }
+
+  for (i = 0; i < threads; i++)
+    pthread_join(workers[i], NULL);
+
+  /* the time of the workers adds up over the threads, the time of 
+     this thread is the time of the whole run */
+  stats_switch(previous);
+  if (flag_stats)
+    {
+      stats_merge(&total_stats, &stats, 0);
+      stats_print(stderr, "total", NULL, &total_stats);
+    }
+
+  pthread_mutex_destroy(&pool.lock);
+  pthread_cond_destroy(&pool.finished);
+
+  fclose(f);
+
+  Free(workers);
+  if (pairs.data != NULL)
+    Free(pairs.data);
+}
@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "adiff.h"
+
+void iset_init_in(interval_set * set, int max_intervals, arena * pool)
+{
+  set->max_intervals = MAX(max_intervals, 1);
+  set->number_of_intervals = 0;
+  set->pool = pool;
+  set->data = Alloc(pool, set->max_intervals * sizeof(item));
+}
+
+void iset_free(interval_set * set)
+{
+  if (set->data != NULL)
+    Release(set->pool, set->data);
+  set->data = NULL;
+  set->number_of_intervals = 0;
+  set->max_intervals = 0;
+}
+
+static void reserve(interval_set * set, int n)
+{
+  int old_max;
+
+  if (n <= set->max_intervals)
+    return;
+
+  old_max = set->max_intervals;
+  set->max_intervals = MAX(2 * old_max, n);
+  set->data = Grow(set->pool, set->data, old_max * sizeof(item), 
+		   set->max_intervals * sizeof(item));
+}
+
+static int compare_begins(const void * x, const void * y)
+{
+  const item * a = x, * b = y;
+
+  if (a->begin != b->begin)
+    return (a->begin < b->begin) ? -1 : 1;
+  return 0;
+}
+
+/* sorts the intervals if needed and merges the ones which overlap 
+   or touch, in place */
+static void normalize(interval_set * set)
+{
+  int i, n, sorted;
+  item * data;
+
+  n = set->number_of_intervals;
+  data = set->data;
+
+  sorted = 1;
+  for (i = 1; (i < n) && sorted; i++)
+    sorted = (data[i - 1].begin <= data[i].begin);
+  if (! sorted)
+    qsort(data, n, sizeof(item), compare_begins);
+
+  set->number_of_intervals = 0;
+  for (i = 0; i < n; i++)
+    {
+      if ((set->number_of_intervals > 0) && 
+	  (data[i].begin <= data[set->number_of_intervals - 1].end + 1))
+	data[set->number_of_intervals - 1].end = 
+	  MAX(data[set->number_of_intervals - 1].end, data[i].end);
+      else
+	data[set->number_of_intervals++] = data[i];
+    }
+}
+
+/* the union of the set with the items of 'type', or with all of the 
+   items for ANY_TYPE; empty items are left out */
+void iset_add_items(interval_set * set, items * Items, pragma_type type)
+{
+  int i, n;
+
+  reserve(set, set->number_of_intervals + Items->number_of_items);
+
+  n = set->number_of_intervals;
+  for (i = 0; i < Items->number_of_items; i++)
+    if (((type == ANY_TYPE) || (Items->data[i].type == type)) && 
+	(Items->data[i].end >= Items->data[i].begin))
+      set->data[n++] = Items->data[i];
+  set->number_of_intervals = n;
+
+  normalize(set);
+}
+
+/* the same as clear, each offset is written once */
+void iset_clear(char * buffer, interval_set * set)
+{
+  int i;
+
+  for (i = 0; i < set->number_of_intervals; i++)
+    memset(buffer + set->data[i].begin, ' ', 
+	   set->data[i].end - set->data[i].begin + 1);
+}
@@ -27,7 +27,7 @@ int match_symbol(char * buffer, int index, char symbol)
       ptr = strchr(buffer + index, symbol);
 
       if (DEBUG_MATCHING)
-	printf("index=%i, buffer[index...]=%s, *ptr=%s\n", index, buffer+index, ptr==NULL?"NULL":ptr);
+	fprintf(output, "index=%i, buffer[index...]=%s, *ptr=%s\n", index, buffer+index, ptr==NULL?"NULL":ptr);
 
       if (ptr != NULL)
 	{
@@ -38,14 +38,14 @@ int match_symbol(char * buffer, int index, char symbol)
 	      begin = index_orig + 1;
 	      end = ptr - buffer - 1;
 	      if (DEBUG_MATCHING)
-		printf("buffer[begin=%i] = %c, buffer[end=%i] = %c\n", 
+		fprintf(output, "buffer[begin=%i] = %c, buffer[end=%i] = %c\n", 
 		       begin, buffer[begin], end, buffer[end], end);
 	      assert(end >= begin); /* should never happen */
 	      flag = 0;
 	      for (i = begin; i <= end; i++)
 		{
 		  if (DEBUG_MATCHING)
-		    printf("%i: %c\n", i, buffer[i]);
+		    fprintf(output, "%i: %c\n", i, buffer[i]);
 		  if (buffer[i] == '\\')
 		    {
 		      if (flag)
@@ -75,7 +75,7 @@ int match_symbol(char * buffer, int index, char symbol)
   while(1);
 
   if (DEBUG_MATCHING)
-    printf("finished: index=%i\n", index);
+    fprintf(output, "finished: index=%i\n", index);
 
   return index;
 }
@@ -105,11 +105,12 @@ int matchComment(char * buffer, int index, items * Items)
   return index;
 }
 
-void find_comments_and_literals(char * orig_buffer, char * buffer, items * Items, int add_literals, int add_comments, int add_backslashes)
+void find_comments_and_literals(source * src, char * buffer, items * Items, int add_literals, int add_comments, int add_backslashes)
 {
   int i, n, end;
 
   n = strlen(buffer);
+  STATS_ADD(COUNT_BYTES, n);
 
   for (i = 0; i < n;)
     {
@@ -136,11 +137,11 @@ void find_comments_and_literals(char * orig_buffer, char * buffer, items * Items
 	    {
 	      if (flag_nested_comments)
 		{
-		  end = match_bracket(orig_buffer, buffer, n, i, "/*", "*/");
+		  end = match_bracket(src, buffer, n, i, "/*", "*/");
 		  if (end < 0)
 		    {
-		      printf("No matching closing comment\n");
-		      exit(-1);
+		      fprintf(output, "No matching closing comment\n");
+		      fatal_error();
 		    }
 		  if (add_comments)
 		    add_item(Items, i, end + 1, COMMENT);
@@ -172,8 +173,8 @@ void find_comments_and_literals(char * orig_buffer, char * buffer, items * Items
 
       if (i < 0)
 	{
-	  printf("Internal error detected\n");
-	  exit(-1);
+	  fprintf(output, "Internal error detected\n");
+	  fatal_error();
 	}
     }
       
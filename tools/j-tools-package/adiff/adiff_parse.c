@@ -5,35 +5,45 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include "adiff.h"
 
 extern int flag_find_full_function;
 
-extern char error_message[1024];
+extern __thread char error_message[1024];
 
 extern int number_of_choices_limit;
 
-int get_line_number(char * buffer, int index)
+extern int number_of_threads;
+
+int get_line_number(source * src, int index)
 {
-  int i, count;
+  int low, high, middle;
 
   if (index < 0)
     return -1;
 
-  if (index > strlen(buffer)) /* must also include the last '0' character */
+  if (index > src->length) /* must also include the last '0' character */
     {
-      printf("Incorrect usage of get_line_number (index = %i, buffer length = %i)\n", 
-	     index, strlen(buffer));
-      exit(-1);
+      fprintf(output, "Incorrect usage of get_line_number (index = %i, buffer length = %i)\n", 
+	     index, src->length);
+      fatal_error();
     }
 
-  count = 1;
-  for (i = 0; i < index; i++)
-    if (buffer[i] == '\n')
-      count++;
+  /* find the last line which begins at or before index */
+  low = 0;
+  high = src->num_lines - 1;
+  while (low < high)
+    {
+      middle = (low + high + 1) / 2;
+      if (src->lines[middle] <= index)
+	low = middle;
+      else
+	high = middle - 1;
+    }
 
-  return count;
+  return low + 1;
 }
 
 void invert(char * src, char * dest)
@@ -47,225 +57,412 @@ void invert(char * src, char * dest)
   dest[n] = 0;
 }
 
-int match_bracket(char * orig_buffer, char * buffer, int n, 
+int match_bracket(source * src, char * buffer, int n, 
 		  int index, char * opening, char * closing)
 {
-  int counter, begin, end, flag, old_index;
-  char * token;
-
-  token = malloc((n + 10) * sizeof(char));
-  assert(token != NULL);
+  int counter, begin, end, second, flag, old_index;
 
   counter = 0;
   flag = 0;
   do
     {
       old_index = index;
-      index = get_token(orig_buffer, buffer, n, index, &begin, &end, token);
+      index = get_token_limits(buffer, n, index, &begin, &end, &second);
 
       if (index < 0)
 	{
-	  Free(token);
 	  sprintf(error_message, "Cannot find token '%s' at line %i", 
-		 opening, get_line_number(orig_buffer, old_index));
+		 opening, get_line_number(src, old_index));
 	  return ERROR;
 	}
 
       if (! flag)
-	if (strcmp(token, opening) != 0)
+	if (! token_equal(buffer, begin, end, second, opening))
 	  {
 	    sprintf(error_message, 
-		    "Invalid call to 'match_bracket': must be '%s' insted of '%s'", 
-		    opening, 
-		    token);
+		    "Invalid call to 'match_bracket': must be '%s' insted of '%.*s'", 
+		    opening, end - begin + 1, buffer + begin);
 	    return ERROR;
 	  }
 
       flag = 1;
 
-      if (strcmp(token, opening) == 0)
+      if (token_equal(buffer, begin, end, second, opening))
 	counter++;
 
-      if (strcmp(token, closing) == 0)
+      if (token_equal(buffer, begin, end, second, closing))
 	counter--;
 
       if (counter == 0)
 	{
-	  Free(token);
 	  if (DEBUG_EXTRACTING)
-	    printf("%s [%s %s] %i %i\n", token, opening, closing, 
-		   get_line_number(orig_buffer, begin), get_line_number(orig_buffer, end));
+	    fprintf(output, "[%s %s] %i %i\n", opening, closing, 
+		   get_line_number(src, begin), get_line_number(src, end));
 	  return begin;
 	}
 
     } while (1);
 
-  Free(token);
-
   return ERROR; /* should never be reached */
 }
 
-int get_next_function(char * orig_buffer, char * buffer, int current,  
+/* 'current' and the returned value are indexes in 'tokens', 
+   which must be produced by tokenize from 'buffer' */
+int get_next_function(source * src, char * buffer, tentries * tokens, int current, 
 		      char * fname, int * fbegin, int * fend, int prev_decl_end)
 {
-  int begin, end, index, n, old_index, flag_found, body_begin, func_name_index;
-  int i, val;
-  char * token, * old_token;
-  
-  n = strlen(buffer);
-  
-  token = malloc((n + 10) * sizeof(char));
-  old_token = malloc((n + 10) * sizeof(char));
+  int n, i, j, prev, close, body, first, len;
+  tentry * token;
 
-  strcpy(token, "");
+  n = strlen(buffer);
+  token = tokens->data;
 
-  index = current;
-  old_index = index;
+  prev = -1;
+  i = current;
 
-  while (1)
+  while (i < tokens->num_tokens)
     {
-      old_index = index;
-      strcpy(old_token, token);
-      index = get_token(orig_buffer, buffer, n, index, &begin, &end, token);
-
-      if (index < 0)
-	break;
-
       if (DEBUG_EXTRACTING)
-	printf("Processing line %i (\"%s\")\n", 
-	       get_line_number(orig_buffer, old_index), token);
+	fprintf(output, "Processing line %i (\"%.*s\")\n", 
+	       get_line_number(src, token[i].begin), 
+	       token[i].end - token[i].begin + 1, buffer + token[i].begin);
 
-      if (strcmp(token, "(") == 0)
+      if (token[i].kind == TOKEN_OPEN_PAREN)
 	{
-	  if (is_identifier(old_token))
-	    {
-	      func_name_index = old_index;
+	  close = token[i].match;
 
-	      strcpy(fname, old_token);
+	  if ((prev >= 0) && (token[prev].kind == TOKEN_IDENTIFIER))
+	    {
+	      len = token[prev].end - token[prev].begin + 1;
+	      strncpy(fname, buffer + token[prev].begin, len);
+	      fname[len] = 0;
 
-	      index = match_bracket(orig_buffer, buffer, n, old_index, "(", ")");
-	      if (index < 0)
+	      if (close < 0)
 		{
 		  sprintf(error_message, "Cannot find matching ')'");
 		  return ERROR;
 		}
-	      old_index = index;
 	  
-	      index++;
-	      if (index >= n)
+	      if (token[close].begin + 1 >= n)
 		{
 		  sprintf(error_message, "Cannot find function body");
 		  return ERROR;
 		}
-		
-	      old_index = index;
-	      index = get_token(orig_buffer, buffer, n, index, &begin, &end, token);
 
-	      if ((strcmp(token, ";") == 0) || (strcmp(token, ",") == 0))
-		continue; /* found function declaration without body */
+	      if ((close + 1 < tokens->num_tokens) && 
+		  ((token[close + 1].kind == TOKEN_SEMICOLON) || 
+		   (token[close + 1].kind == TOKEN_COMMA)))
+		{
+		  /* found function declaration without body */
+		  prev = close + 1;
+		  i = close + 2;
+		  continue;
+		}
 
-	      *fbegin = find_token(orig_buffer, buffer, n, old_index, "{");
+	      for (body = close + 1; body < tokens->num_tokens; body++)
+		if (token[body].kind == TOKEN_OPEN_CURLY)
+		  break;
 
-	      if (*fbegin < 0)
+	      if (body >= tokens->num_tokens)
 		{
 		  sprintf(error_message, "Cannot find function body");
 		  return ERROR;
 		}
 
-	      body_begin = *fbegin;
+	      *fbegin = token[body].begin;
 
 	      if (flag_find_full_function)
 		{
-		  flag_found = 0;
-		  for (i = func_name_index; (i >= 0) && (i > prev_decl_end); i--)
-		    if (buffer[i] == ';')
+		  /* the function begins after the last ';' preceding its name */
+		  first = -1;
+		  for (j = i - 1; (j >= 0) && (token[j].end > prev_decl_end); j--)
+		    if (buffer[token[j].end] == ';')
 		      {
-			flag_found = 1;
-			*fbegin = i + 1;
+			first = j + 1;
 			break;
 		      }
-		  if (! flag_found)
-		    *fbegin = prev_decl_end + 1;
-		  val = get_token(orig_buffer, buffer, n, *fbegin, &begin, &end, token);
-		  if (val < 0)
+		  if (first < 0)
+		    first = find_token_index(tokens, prev_decl_end + 1);
+		  if (first >= tokens->num_tokens)
 		    {
 		      sprintf(error_message, 
 			      "Internal error in 'get_next_function' (no function name and body)");
 		      return ERROR;
 		    }
 
-		  *fbegin = begin;
+		  *fbegin = token[first].begin;
 		}
 
-	      *fend = match_bracket(orig_buffer, buffer, n, body_begin, "{", "}");
-	      if (*fend < 0)
+	      if (token[body].match < 0)
 		{
 		  sprintf(error_message, "Cannot find function body");
 		  return ERROR;
 		}
 
-	      index = *fend + 1;
+	      *fend = token[token[body].match].begin;
 
 	      if (DEBUG_EXTRACTING)
-		printf("Found function '%s' in lines %i ... %i\n", 
-		       fname, get_line_number(orig_buffer, *fbegin), 
-		       get_line_number(orig_buffer, *fend));
-	      Free(token);
+		fprintf(output, "Found function '%s' in lines %i ... %i\n", 
+		       fname, get_line_number(src, *fbegin), 
+		       get_line_number(src, *fend));
 
-	      return index;
+	      return token[body].match + 1;
 	    }
 	  else
 	    {
-	      index = match_bracket(orig_buffer, buffer, n, old_index, "(", ")");
-	      if (index < 0)
+	      if (close < 0)
 		{
 		  sprintf(error_message, "No matching ')'");
 		  return ERROR;
 		}
-	      index++;
+	      prev = i;
+	      i = close + 1;
 	      continue;
 	    }
 	}
 
-      if (strcmp(token, "[") == 0)
+      if (token[i].kind == TOKEN_OPEN_SQUARE)
 	{
-	  index = match_bracket(orig_buffer, buffer, n, old_index, "[", "]");
-	  if (index < 0)
+	  if (token[i].match < 0)
 	    {
 	      sprintf(error_message, "Cannot find matching ']'");
 	      return ERROR;
 	    }
+	  prev = i;
+	  i = token[i].match;
 	  continue;
 	}
 
-      if (strcmp(token, "{") == 0)
+      if (token[i].kind == TOKEN_OPEN_CURLY)
 	{
-	  index = match_bracket(orig_buffer, buffer, n, old_index, "{", "}");
-	  if (index < 0)
+	  if (token[i].match < 0)
 	    {
 	      sprintf(error_message, "Cannot find matching '}'");
 	      return ERROR;
 	    }
+	  prev = i;
+	  i = token[i].match;
 	  continue;
 	}
+
+      prev = i;
+      i++;
     }
 
-  Free(token);
-  
   return END;
 }
 
-int find_functions(char * buffer, fentries * functions)
+/* pragma choices shared by the workers of find_functions */
+typedef struct
 {
-  int i, number_of_choices, choice, counter, x, error, current_number_of_choices;
+  source * src;
+  preprocessed * pre;
   fentries * functions_arr;
+  int * errors;
+  int number_of_choices;
+  int next_choice;
+  int last_error;
+  char last_error_message[1024];
+  int failed; /* a fatal error stopped a choice, the message is printed */
+  pthread_mutex_t lock;
+  FILE * output;
+  pthread_t owner;
+  run_stats helpers; /* the counters of the helpers, for the owner */
+} choice_pool;
+
+/* every worker allocates from its own arenas, they are kept from one 
+   file to the next one and emptied when the worker takes a new pool */
+typedef struct
+{
+  choice_pool * pool;
+  arena results; /* the functions of the choices computed by the worker */
+  arena scratch; /* released after every choice */
+} choice_arenas;
+
+/* the workers are started by the first find_functions which needs 
+   them and wait for the choices of the next files; the thread which 
+   owns 'lock' hands out its pool, the others parse alone */
+typedef struct
+{
+  int helpers;
+  int generation; /* of the pool being handed out */
+  int running; /* helpers which did not finish the pool yet */
+  choice_pool * pool;
+  choice_arenas * arenas;
+  pthread_mutex_t lock, state;
+  pthread_cond_t wake, finished;
+} worker_team;
+
+static worker_team team = {0, 0, 0, NULL, NULL, 
+			   PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, 
+			   PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER};
+
+/* the arenas of a thread which parses its own choices */
+static __thread choice_arenas own_arenas;
+
+/* for the threads which end before the program */
+void free_choice_arenas(void)
+{
+  if (own_arenas.results.first == NULL)
+    return;
+
+  arena_free(&own_arenas.results);
+  arena_free(&own_arenas.scratch);
+}
+
+static void init_arenas(choice_arenas * arenas, choice_pool * pool)
+{
+  if (arenas->results.first == NULL)
+    {
+      arena_init(&arenas->results, 64 * 1024);
+      arena_init(&arenas->scratch, 64 * 1024);
+    }
+  else
+    {
+      arena_reset(&arenas->results);
+      arena_reset(&arenas->scratch);
+    }
+  arenas->pool = pool;
+}
+
+/* a fatal error of a choice does not leave the other workers with the 
+   pool of a returned find_functions: the choices are stopped and the 
+   owner repeats the error when all of the workers are done */
+static void choice_worker(choice_arenas * arenas)
+{
+  choice_pool * pool = arenas->pool;
+  jmp_buf * saved = recovery;
+  arena_mark mark;
+  jmp_buf env;
+  int choice;
+
+  output = pool->output;
+  recovery = &env;
+  mark = arena_get_mark(&arenas->scratch);
+
+  if (setjmp(env) != 0)
+    {
+      arena_release(&arenas->scratch, mark);
+      pthread_mutex_lock(&pool->lock);
+      pool->failed = 1;
+      pool->next_choice = pool->number_of_choices;
+      pthread_mutex_unlock(&pool->lock);
+    }
+
+  while (1)
+    {
+      pthread_mutex_lock(&pool->lock);
+      choice = pool->next_choice++;
+      pthread_mutex_unlock(&pool->lock);
+
+      if (choice >= pool->number_of_choices)
+	break;
+
+      finit_in(&pool->functions_arr[choice], 100, &arenas->results);
+      strcpy(error_message, "");
+      pool->errors[choice] = (find_functions_internal(pool->src, pool->pre, 
+						      &pool->functions_arr[choice], 
+						      choice, &arenas->scratch) == ERROR);
+      arena_release(&arenas->scratch, mark);
+      if (pool->errors[choice])
+	{
+	  if (DEBUG_WARNINGS)
+	    fprintf(output, "WARNING: Parse error %i-th pragma choice \"%s\"\n", 
+		   choice, error_message);
+
+	  /* the message of the last choice is reported when all of them fail */
+	  pthread_mutex_lock(&pool->lock);
+	  if (choice > pool->last_error)
+	    {
+	      pool->last_error = choice;
+	      strcpy(pool->last_error_message, error_message);
+	    }
+	  pthread_mutex_unlock(&pool->lock);
+
+	  if (FREE)
+	    ffree(&pool->functions_arr[choice]);
+	}
+    }
+
+  recovery = saved;
+
+  /* the time of the helpers runs along the time of the owner, 
+     only their counters are added up */
+  if (flag_stats && ! pthread_equal(pthread_self(), pool->owner))
+    {
+      pthread_mutex_lock(&pool->lock);
+      stats_merge(&pool->helpers, &stats, 0);
+      pthread_mutex_unlock(&pool->lock);
+      memset(&stats, 0, sizeof(stats));
+    }
+}
+
+static void * team_worker(void * arg)
+{
+  choice_arenas * arenas = arg;
+  int generation = 0;
+
+  while (1)
+    {
+      pthread_mutex_lock(&team.state);
+      while (team.generation == generation)
+	pthread_cond_wait(&team.wake, &team.state);
+      generation = team.generation;
+      init_arenas(arenas, team.pool);
+      pthread_mutex_unlock(&team.state);
+
+      choice_worker(arenas);
+
+      pthread_mutex_lock(&team.state);
+      if (--team.running == 0)
+	pthread_cond_signal(&team.finished);
+      pthread_mutex_unlock(&team.state);
+    }
+
+  return NULL;
+}
+
+/* the caller owns team.lock */
+static void start_team(int helpers)
+{
+  pthread_t worker;
+  int i;
+
+  if (team.arenas != NULL)
+    return;
+
+  team.arenas = Malloc(helpers * sizeof(choice_arenas));
+  memset(team.arenas, 0, helpers * sizeof(choice_arenas));
+  for (i = 0; i < helpers; i++)
+    {
+      if (pthread_create(&worker, NULL, team_worker, &team.arenas[i]) != 0)
+	{
+	  fprintf(output, "Cannot create thread\n");
+	  pthread_mutex_unlock(&team.lock);
+	  fatal_error();
+	}
+      pthread_detach(worker);
+      team.helpers++;
+    }
+}
+
+int find_functions(source * src, fentries * functions)
+{
+  int i, counter, threads, current_number_of_choices;
+  preprocessed pre;
+  choice_pool pool;
+  stats_phase previous;
   
-  find_functions_internal(buffer, functions, -1, &number_of_choices);
+  previous = stats_switch(PHASE_SCAN);
+  preprocess(src, &pre);
+  stats_switch(PHASE_FUNCTIONS);
 
-  current_number_of_choices = number_of_choices;
+  current_number_of_choices = pre.number_of_choices;
+  STATS_ADD(COUNT_CHOICE_SPACE, current_number_of_choices);
   if (current_number_of_choices > number_of_choices_limit)
     {
-      printf("%s%i%s%i%s\n", 
+      STATS_ADD(COUNT_CAPPED, 1);
+      fprintf(output, "%s%i%s%i%s\n", 
 	     "WARNING: search space for pragmas in too large (number_of_choices = ", 
 	     current_number_of_choices, 
 	     "), reducing it to ", 
@@ -273,95 +470,146 @@ int find_functions(char * buffer, fentries * functions)
 	     ": RESULTS CAN BE INCORRECT");
       current_number_of_choices = number_of_choices_limit;
     }
+  current_number_of_choices = MAX(current_number_of_choices, 0);
+  STATS_ADD(COUNT_CHOICES, current_number_of_choices);
 
-  functions_arr = Malloc((number_of_choices + 10) * sizeof(fentries));
-
-  counter = 0;
+  pool.src = src;
+  pool.pre = &pre;
+  pool.functions_arr = Malloc((current_number_of_choices + 10) * sizeof(fentries));
+  pool.errors = Malloc((current_number_of_choices + 10) * sizeof(int));
   for (i = 0; i < current_number_of_choices; i++)
+    pool.errors[i] = 1; /* for the choices a fatal error leaves behind */
+  pool.number_of_choices = current_number_of_choices;
+  pool.next_choice = 0;
+  pool.last_error = -1;
+  pool.failed = 0;
+  pool.output = output;
+  pool.owner = pthread_self();
+  memset(&pool.helpers, 0, sizeof(pool.helpers));
+  strcpy(pool.last_error_message, error_message);
+  pthread_mutex_init(&pool.lock, NULL);
+
+  /* the owner parses choices too, next to number_of_threads - 1 helpers */
+  threads = MAX(MIN(number_of_threads, current_number_of_choices), 1);
+  if ((threads > 1) && (pthread_mutex_trylock(&team.lock) != 0))
+    threads = 1;
+
+  if (threads > 1)
     {
-      finit(&functions_arr[counter], 100);
-      strcpy(error_message, "");
-      error = find_functions_internal(buffer, &functions_arr[counter], i, &x);
-      assert(x == number_of_choices);
-      if (error != ERROR)
-	counter++;
-      else
-	{
-	  if (DEBUG_WARNINGS)
-	    printf("WARNING: Parse error %i-th pragma choice \"%s\"\n", 
-		   i, error_message);
-	}
-      /*
-      if (i != max_selector)
-	func_free(functions);
-      */
+      start_team(number_of_threads - 1);
+
+      pthread_mutex_lock(&team.state);
+      team.pool = &pool;
+      team.running = team.helpers;
+      team.generation++;
+      pthread_cond_broadcast(&team.wake);
+      pthread_mutex_unlock(&team.state);
     }
 
-  if (counter == 0)
+  init_arenas(&own_arenas, &pool);
+  choice_worker(&own_arenas);
+
+  if (threads > 1)
     {
-      printf("ERROR: %s\n", error_message);
-      exit(-1);
+      pthread_mutex_lock(&team.state);
+      while (team.running > 0)
+	pthread_cond_wait(&team.finished, &team.state);
+      team.pool = NULL;
+      pthread_mutex_unlock(&team.state);
     }
+  if (flag_stats)
+    stats_merge(&stats, &pool.helpers, 0);
+
+  pthread_mutex_destroy(&pool.lock);
+
+  /* merge in the order of choices, whatever order they were computed in */
+  counter = 0;
+  for (i = 0; i < current_number_of_choices; i++)
+    if (! pool.errors[i])
+      pool.functions_arr[counter++] = pool.functions_arr[i];
+
+  if (! pool.failed && (counter > 0))
+    select_best_func_limits(pool.functions_arr, counter, functions);
 
-  select_best_func_limits(functions_arr, counter, functions);
+  /* the functions of the helpers are copied, they can take the next pool */
+  if (threads > 1)
+    pthread_mutex_unlock(&team.lock);
+
+  if (pool.failed || (counter == 0))
+    {
+      if (! pool.failed)
+	fprintf(output, "ERROR: %s\n", pool.last_error_message);
+      Free(pool.functions_arr);
+      Free(pool.errors);
+      free_preprocessed(&pre);
+      fatal_error();
+    }
 
   if (check_func_duplicates(functions))
     {
-      printf("WARNING: duplicate function names found: RESULTS CAN BE INCORRECT\n");
+      fprintf(output, "WARNING: duplicate function names found: RESULTS CAN BE INCORRECT\n");
     }
 
   if (check_func_overlap(functions))
     {
-      printf("%s%s\n", 
+      fprintf(output, "%s%s\n", 
 	     "WARNING: function declarations overlapped: ", 
 	     "RESULTS can show more changed functions than necessary");
     }
 
   if (FREE)
-    Free(functions_arr);
+    {
+      Free(pool.functions_arr);
+      Free(pool.errors);
+    }
+
+  free_preprocessed(&pre);
+
+  stats_switch(previous);
+
+  return 0;
 }
 
 int check_func_duplicates(fentries * functions)
 {
-  int i, j, n;
+  int i, n;
 
   n = functions->num_funcs;
 
   for (i = 0; i < n; i++)
-    {
-      for (j = 0; j < n; j++)
-	if (i != j)
-	  if (strcmp(functions->data[i].fname, functions->data[j].fname) == 0)
-	    return 1;
-    }
+    if (ffind(functions, functions->data[i].fname) != i)
+      return 1;
 
   return 0;
 }
 
+/* two functions overlap when one of them begins inside the other one: 
+   after sorting by the beginning it is enough to compare each function 
+   with the furthest end seen so far */
 int check_func_overlap(fentries * functions)
 {
-  int i, j, n;
+  int i, n, max_end, overlap;
+  finterval * intervals;
 
   n = functions->num_funcs;
 
-  for (i = 0; i < n; i++)
-    {
-      for (j = 0; j < n; j++)
-	if (i != j)
-	  {
-	    if (between(functions->data[i].fbegin, 
-			functions->data[j].fbegin, 
-			functions->data[j].fend))
-	      return 1;
+  intervals = create_func_intervals(functions);
 
-	    if (between(functions->data[i].fend, 
-			functions->data[j].fbegin, 
-			functions->data[j].fend))
-	      return 1;
-	  }
+  overlap = 0;
+  max_end = (n > 0) ? (intervals[0].fend) : (0);
+  for (i = 1; i < n; i++)
+    {
+      if (intervals[i].fbegin <= max_end)
+	{
+	  overlap = 1;
+	  break;
+	}
+      max_end = MAX(max_end, intervals[i].fend);
     }
 
-  return 0;
+  Free(intervals);
+
+  return overlap;
 }
 
 /*
@@ -395,28 +643,21 @@ int between(int x, int min, int max)
 }
 
 
+/* 'destination' must be initialized by the caller */
 void select_best_func_limits(fentries * source, int counter, fentries * destination)
 {
-  int i, j, k, found;
-
-  finit(destination, 100);
+  int i, j, k;
 
   for (i = 0; i < counter; i++)
     {
       for (j = 0; j < source[i].num_funcs; j++)
 	{
-	  found = 0;
-	  for (k = 0; k < destination->num_funcs; k++)
-	    if (strcmp(destination->data[k].fname, source[i].data[j].fname) == 0)
-	      {
-		found = 1;
-		break;
-	      }
-
-	  if (found)
+	  k = ffind(destination, source[i].data[j].fname);
+
+	  if (k >= 0)
 	    {
 	      if (DEBUG_PRAGMAS_1)
-		printf("Updating \"%s\"...\n", source[i].data[j].fname);
+		fprintf(output, "Updating \"%s\"...\n", source[i].data[j].fname);
 	      destination->data[k].fbegin = MIN(destination->data[k].fbegin, 
 						source[i].data[j].fbegin);
 	      destination->data[k].fend = MAX(destination->data[k].fend, 
@@ -425,7 +666,7 @@ void select_best_func_limits(fentries * source, int counter, fentries * destinat
 	  else
 	    {
 	      if (DEBUG_PRAGMAS_1)
-		printf("Adding \"%s\"...\n", source[i].data[j].fname);
+		fprintf(output, "Adding \"%s\"...\n", source[i].data[j].fname);
 	      fadd(destination, source[i].data[j].fname, 
 		   source[i].data[j].fbegin, source[i].data[j].fend);
 	    }
@@ -433,97 +674,118 @@ void select_best_func_limits(fentries * source, int counter, fentries * destinat
     }
 }
 
-int find_functions_internal(char * buffer, fentries * functions, 
-			    int choice, int * number_of_choices)
+/* the part of the parsing which does not depend on the pragma choice */
+void preprocess(source * src, preprocessed * pre)
 {
-  int counter, n, m, i, val, prev_decl_end;
-  char * newbuffer;
-  int len;
-  char buff[MAX_NAME_LENGTH];
-  items Items, Items_pragmas, Items_pragmas_other, 
-    Items_pragmas_control, Items_pragmas_unselected;
-  char * name;
-  int begin, end, index;
-  element * Pragmas;
-  depth_width dw;
-  int * selectors;
+  int n, val;
+  items Items, Items_pragmas, Items_pragmas_control;
+  interval_set cleared;
+  jmp_buf env, * saved;
 
-  n = strlen(buffer);
+  n = src->length;
+
+  arena_init(&pre->pool, 64 * 1024);
 
-  name = Malloc((n + 10) * sizeof(char));
+  /* the arena goes before a parse error goes on to the caller */
+  saved = recovery;
+  recovery = &env;
+  if (setjmp(env) != 0)
+    {
+      free_preprocessed(pre);
+      recovery = saved;
+      fatal_error();
+    }
 
-  init_items(&Items, n + 10);
+  init_items_in(&Items, n + 10, &pre->pool);
 
-  newbuffer = strdup(buffer);
-  assert(newbuffer != NULL);
+  pre->buffer = arena_alloc(&pre->pool, n + 1);
+  strcpy(pre->buffer, src->data);
+  pre->length = strlen(pre->buffer);
 
-  find_comments_and_literals(buffer, newbuffer, &Items, 1, 1, 1);
-  clear(newbuffer, &Items);
+  find_comments_and_literals(src, pre->buffer, &Items, 1, 1, 1);
+  clear(pre->buffer, &Items);
 
-  init_items(&Items_pragmas, n + 10);
+  stats_switch(PHASE_PRAGMAS);
+  init_items_in(&Items_pragmas, n + 10, &pre->pool);
 
-  find_pragmas(buffer, newbuffer, &Items_pragmas);
+  find_pragmas(src, pre->buffer, &Items_pragmas);
 
-  copy_items_type(&Items_pragmas, &Items_pragmas_other, PRAGMA_OTHER);
-  clear(newbuffer, &Items_pragmas_other);
   delete_items_type(&Items_pragmas, &Items_pragmas_control, PRAGMA_OTHER);
   
   if (DEBUG_PRAGMAS)
-    print_items(buffer, &Items_pragmas);
+    print_items(src, &Items_pragmas);
 
-  *number_of_choices = 1;
+  pre->number_of_choices = 1;
+  pre->Pragmas = NULL;
 
   if (Items_pragmas_control.number_of_items > 0)
     {
-      Pragmas = parse_AND_pragmas(buffer, &Items_pragmas_control, 
-			      0, Items_pragmas_control.number_of_items - 1, &val);
+      pre->Pragmas = parse_AND_pragmas(src, &Items_pragmas_control, 0, 
+				       Items_pragmas_control.number_of_items - 1, &val);
 
-      fill_pdata(buffer, &Items_pragmas_control, Pragmas);
-      fill_tdata(buffer, &Items_pragmas_control, Pragmas);
+      fill_pdata(src, &Items_pragmas_control, pre->Pragmas);
+      fill_tdata(src, &Items_pragmas_control, pre->Pragmas);
 
       if (DEBUG_PRAGMAS)
-	print_pragmas(buffer, Pragmas, 0);
+	print_pragmas(src, pre->Pragmas, 0);
+
+      pre->number_of_choices = count_choices(pre->Pragmas);
+    }
+
+  /* the parsing of the pragmas only needs their items, the lines of all 
+     of them are cleared at once; the unselected branches are cleared 
+     for every choice in addition */
+  iset_init_in(&cleared, Items_pragmas.number_of_items, &pre->pool);
+  iset_add_items(&cleared, &Items_pragmas, ANY_TYPE);
+  iset_clear(pre->buffer, &cleared);
+
+  free_items(&Items);
+  free_items(&Items_pragmas);
+  free_items(&Items_pragmas_control);
+  recovery = saved;
+}
 
-      dw = compute_depth_width(Pragmas);
+void free_preprocessed(preprocessed * pre)
+{
+  arena_free(&pre->pool);
+  pre->Pragmas = NULL;
+  pre->buffer = NULL;
+}
 
-      selectors = malloc((dw.depth + 10) * sizeof(int));
+/* the temporary data of the choice is allocated from 'scratch', 
+   which the caller releases */
+int find_functions_internal(source * src, preprocessed * pre, 
+			    fentries * functions, int choice, arena * scratch)
+{
+  int index, begin, end, prev_decl_end;
+  char * newbuffer, * name;
+  items Items_pragmas_unselected;
+  tentries Tokens;
 
-      *number_of_choices = compute_VS(dw);
+  name = arena_alloc(scratch, (pre->length + 10) * sizeof(char));
 
-      if (choice >= 0)
-	{
-	  create_selectors(dw, choice, selectors);
-	  
-	  select_branch(buffer, newbuffer, Pragmas, &Items_pragmas_unselected, selectors);
-	  
-	  clear(newbuffer, &Items_pragmas_unselected);
-	}
+  newbuffer = arena_alloc(scratch, (pre->length + 1) * sizeof(char));
+  memcpy(newbuffer, pre->buffer, pre->length + 1);
 
-      free_pragmas(Pragmas);
+  if (pre->Pragmas != NULL)
+    {
+      select_branch(src, newbuffer, pre->Pragmas, &Items_pragmas_unselected, 
+		    choice, scratch);
+	  
+      clear(newbuffer, &Items_pragmas_unselected);
     }
 
-  clear(newbuffer, &Items_pragmas);
+  tokenize(src, newbuffer, &Tokens, scratch);
 
   index = 0;
-  if (choice >= 0)
+  prev_decl_end = -1;
+  while ((index = get_next_function(src, newbuffer, &Tokens, index, 
+				    name, &begin, &end, prev_decl_end)) >= 0)
     {
-      index = 0;
-      prev_decl_end = -1;
-      while ((index = get_next_function(buffer, newbuffer, index, 
-					name, &begin, &end, prev_decl_end)) >= 0)
-	{
-	  prev_decl_end = end;
-	  fadd(functions, name, begin, end);
-	}
+      prev_decl_end = end;
+      fadd(functions, name, begin, end);
     }
 
-  Free(newbuffer);
-  free_items(&Items);
-  free_items(&Items_pragmas);
-  free_items(&Items_pragmas_other);
-  free_items(&Items_pragmas_control);
-  free_items(&Items_pragmas_unselected);
-
   return index;
 }
 
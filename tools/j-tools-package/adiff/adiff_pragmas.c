@@ -8,7 +8,8 @@
 
 #include "adiff.h"
 
-void find_pragmas(char * orig_buffer, char * buffer, items * pragmas)
+/* 'pragmas' must be initialized by the caller */
+void find_pragmas(source * src, char * buffer, items * pragmas)
 {
   int lbegin, lend, index, n;
   char * token, * line;
@@ -20,27 +21,28 @@ void find_pragmas(char * orig_buffer, char * buffer, items * pragmas)
 
   line = Malloc((n + 10) * sizeof(char));
 
-  init_items(pragmas, 10);
-
   index = 0;
   while (1)
     {
-      index = get_line(orig_buffer, buffer, n, index, &lbegin, &lend, line);
+      index = get_line(src, buffer, n, index, &lbegin, &lend, line);
       if (index < 0)
 	break;
 
-      ptype = extract_pragma_name(line);
+      ptype = extract_pragma_name(src, line);
 
       if (ptype == OTHER)
 	continue;
 
       add_item(pragmas, lbegin, lend, ptype);
     }
+
+  Free(token);
+  Free(line);
 }
 
 /* assumes that there are no '\' before the end of line, those symbols must be removed together 
 with the end of line */
-int get_line(char * orig_buffer, char * buffer, int n, int index, int * lbegin, int * lend, char * line)
+int get_line(source * src, char * buffer, int n, int index, int * lbegin, int * lend, char * line)
 {
   int m;
 
@@ -58,7 +60,7 @@ int get_line(char * orig_buffer, char * buffer, int n, int index, int * lbegin,
   return ((*lend) + 1);
 }
 
-int find_next_pragma(char * orig_buffer, items * input, int start, int end)
+int find_next_pragma(source * src, items * input, int start, int end)
 {
   int found, counter, index;
   item Item;
@@ -75,7 +77,7 @@ int find_next_pragma(char * orig_buffer, items * input, int start, int end)
       Item = input->data[index];
 
       if (DEBUG_PRAGMAS)
-	printf("Scanning %s at %i\n", types_enum2str(Item.type), get_line_number(orig_buffer, Item.begin));
+	fprintf(output, "Scanning %s at %i\n", types_enum2str(Item.type), get_line_number(src, Item.begin));
 
       switch (Item.type)
 	{
@@ -95,19 +97,19 @@ int find_next_pragma(char * orig_buffer, items * input, int start, int end)
 	  break;
 
 	default:
-	  printf("Invalid pragma type\n"); /* other types must be filtered out before */
-	  exit(-1);
+	  fprintf(output, "Invalid pragma type\n"); /* other types must be filtered out before */
+	  fatal_error();
 	  break;
 	}
     }
 
-  printf("Cound not find closing pragma starting from %i and ending at %i\n", 
-	 get_line_number(orig_buffer, input->data[start].begin),
-	 get_line_number(orig_buffer, input->data[end].end));
-  exit(-1);
+  fprintf(output, "Cound not find closing pragma starting from %i and ending at %i\n", 
+	 get_line_number(src, input->data[start].begin),
+	 get_line_number(src, input->data[end].end));
+  fatal_error();
 }
 
-element * parse_OR_pragmas(char * orig_buffer, items * input, int begin, int end, int * _index)
+element * parse_OR_pragmas(source * src, items * input, int begin, int end, int * _index)
 {
   item oldItem, Item;
   element * Pragmas, * p;
@@ -115,11 +117,11 @@ element * parse_OR_pragmas(char * orig_buffer, items * input, int begin, int end
   int done;
 
   if (DEBUG_PRAGMAS)
-    printf("Entering 'parse_OR_pragmas' with [%i, %i]\n", begin, end);
+    fprintf(output, "Entering 'parse_OR_pragmas' with [%i, %i]\n", begin, end);
 
   Pragmas = NULL;
 
-  Pragmas = create_pragmas(-1, -1, -1, -1, -1, OR, 10);
+  Pragmas = create_pragmas(-1, -1, -1, -1, -1, OR, 10, input->pool);
 
   /*
   if (begin < 0)
@@ -137,33 +139,33 @@ element * parse_OR_pragmas(char * orig_buffer, items * input, int begin, int end
     {
       oldindex = index;
       if (done)
-	index = find_next_pragma(orig_buffer, input, index + 1, end);
+	index = find_next_pragma(src, input, index + 1, end);
 
       oldItem = input->data[oldindex];
 
       if (index == -1)
 	{
-	  printf("Cannot find matching #else or #endif for #if pragma at %i\n", 
-		 get_line_number(orig_buffer, oldItem.begin));
-	  exit(-1);
+	  fprintf(output, "Cannot find matching #else or #endif for #if pragma at %i\n", 
+		 get_line_number(src, oldItem.begin));
+	  fatal_error();
 	}
 
       Item = input->data[index];
 
       if (DEBUG_PRAGMAS)
-	printf("Parsing pragmas in 'parse_OR_pragmas' at %i\n", get_line_number(orig_buffer, Item.begin));
+	fprintf(output, "Parsing pragmas in 'parse_OR_pragmas' at %i\n", get_line_number(src, Item.begin));
 
       if (! done)
 	{
 	  if (oldItem.type != PRAGMA_IF)
 	    {
-	      printf("%s%s%s", "Internal error in parsing pragmas: ", 
+	      fprintf(output, "%s%s%s", "Internal error in parsing pragmas: ", 
 		     "call to 'parse_OR_pragmas' ", 
 		     "was made without #if present\n");
-	      exit(-1);
+	      fatal_error();
 	    }
 	  /*
-	  p = parse_AND_pragmas(orig_buffer, input, oldindex + 1, index - 1, &x);
+	  p = parse_AND_pragmas(src, input, oldindex + 1, index - 1, &x);
 	  p->pid = index;
 	  add_pragma(Pragmas, p);
 	  */
@@ -174,23 +176,23 @@ element * parse_OR_pragmas(char * orig_buffer, items * input, int begin, int end
 	  switch(Item.type)
 	    {
 	    case PRAGMA_IF:
-	      printf("%s%s%s%i\n", 
+	      fprintf(output, "%s%s%s%i\n", 
 		     "Internal error in parsing pragmas: ", 
 		     "program used #if from the lower level ", 
 		     "to be as in the upper level at ", 
-		     get_line_number(orig_buffer, Item.begin));
-	      exit(-1);
+		     get_line_number(src, Item.begin));
+	      fatal_error();
 
 	    case PRAGMA_ELSE:
-	      p = parse_AND_pragmas(orig_buffer, input, oldindex + 1, index - 1, &x);
+	      p = parse_AND_pragmas(src, input, oldindex + 1, index - 1, &x);
 	      p->pid = oldindex;
 	      add_pragma(Pragmas, p);
 	      break;
 
 	    case PRAGMA_ENDIF:
 	      if (DEBUG_PRAGMAS)
-		printf("Exiting 'parse_OR_pragmas'\n");
-	      p = parse_AND_pragmas(orig_buffer, input, oldindex + 1, index - 1, &x);
+		fprintf(output, "Exiting 'parse_OR_pragmas'\n");
+	      p = parse_AND_pragmas(src, input, oldindex + 1, index - 1, &x);
 	      p->pid = oldindex;
 	      add_pragma(Pragmas, p);
 	      /*
@@ -206,18 +208,18 @@ element * parse_OR_pragmas(char * orig_buffer, items * input, int begin, int end
 	    case COMMENT:
 	    case OTHER:
 	    case ESCSEQ:
-	      printf("Internal error in pragmas handling\n");
-	      exit(-1);
+	      fprintf(output, "Internal error in pragmas handling\n");
+	      fatal_error();
 	    }
 	}
     }
 
   /* should never be reached */
-  printf("Reached unreachable code\n");
-  exit(-1);
+  fprintf(output, "Reached unreachable code\n");
+  fatal_error();
 }
 
-element * parse_AND_pragmas(char * orig_buffer, items * input, int begin, int end, int * _index)
+element * parse_AND_pragmas(source * src, items * input, int begin, int end, int * _index)
 {
   item Item;
   element * Pragmas, * p;
@@ -225,7 +227,7 @@ element * parse_AND_pragmas(char * orig_buffer, items * input, int begin, int en
 
   Pragmas = NULL;
 
-  Pragmas = create_pragmas(-1, -1, -1, -1, -1, AND, 10);
+  Pragmas = create_pragmas(-1, -1, -1, -1, -1, AND, 10, input->pool);
 
   /*
   if (begin < 0)
@@ -237,12 +239,12 @@ element * parse_AND_pragmas(char * orig_buffer, items * input, int begin, int en
   index = begin;
 
   if (DEBUG_PRAGMAS)
-    printf("Entering 'parse_AND_pragmas' with [%i, %i]\n", begin, end);
+    fprintf(output, "Entering 'parse_AND_pragmas' with [%i, %i]\n", begin, end);
 
   if (begin > end)
     {
       if (DEBUG_PRAGMAS)
-	printf("Exiting 'parse_AND_pragmas'\n");
+	fprintf(output, "Exiting 'parse_AND_pragmas'\n");
       *_index = -1;
       return Pragmas;
     }
@@ -257,27 +259,27 @@ element * parse_AND_pragmas(char * orig_buffer, items * input, int begin, int en
 	{
 	case PRAGMA_IF: 
 	  if (DEBUG_PRAGMAS)
-	    printf("#if detected in 'parse_AND_pragmas' at %i\n", 
-		   get_line_number(orig_buffer, Item.begin));
+	    fprintf(output, "#if detected in 'parse_AND_pragmas' at %i\n", 
+		   get_line_number(src, Item.begin));
 
 	  old_index = index;
-	  p = parse_OR_pragmas(orig_buffer, input, old_index, end, &index);
+	  p = parse_OR_pragmas(src, input, old_index, end, &index);
 	  p->pid = old_index;
 	  add_pragma(Pragmas, p);
 
 	  index++;
 
 	  if (DEBUG_PRAGMAS)
-	    printf("#if clause starting at %i was added successfully, next pragma number is %i\n", 
-		   get_line_number(orig_buffer, Item.begin), 
+	    fprintf(output, "#if clause starting at %i was added successfully, next pragma number is %i\n", 
+		   get_line_number(src, Item.begin), 
 		   index);
 	  break;
 
 	case PRAGMA_ELSE:
 	case PRAGMA_ENDIF:
-	  printf("#else or #endif appear without #if at %i\n", 
-		 get_line_number(orig_buffer, Item.begin));
-  	  exit(-1);
+	  fprintf(output, "#else or #endif appear without #if at %i\n", 
+		 get_line_number(src, Item.begin));
+  	  fatal_error();
 	  break;
 
 	case PRAGMA_OTHER:
@@ -286,82 +288,90 @@ element * parse_AND_pragmas(char * orig_buffer, items * input, int begin, int en
 	case COMMENT:
 	case OTHER:
 	case ESCSEQ:
-	  printf("Internal error in pragmas handling: more pragma types are present than should be\n");
-	  exit(-1);
+	  fprintf(output, "Internal error in pragmas handling: more pragma types are present than should be\n");
+	  fatal_error();
 	}
     }
 
   if (DEBUG_PRAGMAS)
-    printf("Exiting 'parse_AND_pragmas'\n");
+    fprintf(output, "Exiting 'parse_AND_pragmas'\n");
 
   *_index = index;
   return Pragmas;
 }
 
-void select_branch(char * orig_buffer, char * buffer, 
-		   element * Pragmas, items * deleted, int * selectors)
+void select_branch(source * src, char * buffer, 
+		   element * Pragmas, items * deleted, int choice, arena * pool)
 {
-  init_items(deleted, 10);
+  init_items_in(deleted, 10, pool);
 
-  select_branch_internal(orig_buffer, buffer, Pragmas, deleted, selectors, 0);
+  select_branch_internal(src, buffer, Pragmas, deleted, choice);
 }
 
-void select_branch_internal(char * orig_buffer, char * buffer, 
-			    element * Pragmas, items * deleted, 
-			    int * selectors, int depth)
+/* the choices of an OR-type pragma are the choices of its first branch, 
+   then the choices of the second one, and so on; the parts of an 
+   AND-type pragma are independent #if blocks, they go through their 
+   choices at the same time */
+void select_branch_internal(source * src, char * buffer, 
+			    element * Pragmas, items * deleted, int choice)
 {
   int i, n, selector;
 
   n = Pragmas->number_of_elements;
   if (Pragmas->type == OR)
     {
-      selector = selectors[depth];
-      if (selector >= n)
-	selector = n - 1;
+      for (selector = 0; selector < n - 1; selector++)
+	{
+	  if (choice < Pragmas->list[selector]->number_of_choices)
+	    break;
+	  choice -= Pragmas->list[selector]->number_of_choices;
+	}
       for (i = 0; i < n; i++)
 	{
 	  if (i != selector)
 	    add_item(deleted, Pragmas->list[i]->text_begin, 
 		     Pragmas->list[i]->text_end, OTHER);
 	}
-      select_branch_internal(orig_buffer, buffer, Pragmas->list[selector], 
-			     deleted, selectors, depth + 1);
+      select_branch_internal(src, buffer, Pragmas->list[selector], 
+			     deleted, choice);
     }
   else
     {
       for (i = 0; i < n; i++)
-	select_branch_internal(orig_buffer, buffer, Pragmas->list[i], 
-			       deleted, selectors, depth); /* should be the same depth */
+	select_branch_internal(src, buffer, Pragmas->list[i], deleted, 
+			       choice % Pragmas->list[i]->number_of_choices);
     }
 }
 
-depth_width compute_depth_width(element * Pragmas)
+/* the number of choices which select every branch at least once: the 
+   sum over the branches of an OR-type pragma, the largest number of 
+   the independent parts of an AND-type one, instead of the product 
+   over all of the pragmas */
+int count_choices(element * Pragmas)
 {
-  int i, n;
-  depth_width dw, max_dw;
+  int i, n, choices;
 
   n = Pragmas->number_of_elements;
 
-  max_dw.depth = 0;
-  max_dw.width = 0;
-
+  choices = (Pragmas->type == OR) ? (0) : (1);
   for (i = 0; i < n; i++)
     {
-      dw = compute_depth_width(Pragmas->list[i]);
-      max_dw.depth = MAX(max_dw.depth, dw.depth);
-      max_dw.width = MAX(max_dw.width, dw.width);
+      if (Pragmas->type == OR)
+	choices += count_choices(Pragmas->list[i]);
+      else
+	choices = MAX(choices, count_choices(Pragmas->list[i]));
     }
+  Pragmas->number_of_choices = MAX(choices, 1);
 
-  if (Pragmas->type == OR)
-    {
-      max_dw.depth++;
-      max_dw.width = MAX(max_dw.width, n);
-    }
+  if (DEBUG_SELECTORS)
+    fprintf(output, "%s pragma at offset %i: number of choices = %i\n", 
+	   comp_types_enum2str(Pragmas->type), Pragmas->text_begin, 
+	   Pragmas->number_of_choices);
 
-  return max_dw;
+  return Pragmas->number_of_choices;
 }
 
-void fill_pdata(char * orig_buffer, items * inputs, element * Pragma)
+void fill_pdata(source * src, items * inputs, element * Pragma)
 {
   int i, ne, ni;
   item Item;
@@ -386,17 +396,17 @@ void fill_pdata(char * orig_buffer, items * inputs, element * Pragma)
   Pragma->text_end = -1;
 
   for (i = 0; i < ne; i++)
-    fill_pdata(orig_buffer, inputs, Pragma->list[i]);
+    fill_pdata(src, inputs, Pragma->list[i]);
 }
 
-void fill_tdata(char * orig_buffer, items * inputs, element * Pragma)
+void fill_tdata(source * src, items * inputs, element * Pragma)
 {
   int i, ne, first, last;
 
   ne = Pragma->number_of_elements;
 
   for (i = 0; i < ne; i++)
-    fill_tdata(orig_buffer, inputs, Pragma->list[i]);
+    fill_tdata(src, inputs, Pragma->list[i]);
 
   switch (Pragma->type)
     {
@@ -409,8 +419,8 @@ void fill_tdata(char * orig_buffer, items * inputs, element * Pragma)
 	}
       else
 	{
-	  printf("Incorrect usage of OR-type pragma (internal error)\n");
-	  exit(-1);
+	  fprintf(output, "Incorrect usage of OR-type pragma (internal error)\n");
+	  fatal_error();
 	}
       break;
 
@@ -424,8 +434,8 @@ void fill_tdata(char * orig_buffer, items * inputs, element * Pragma)
 	{
 	  if (Pragma->pid < 0)
 	    {
-	      printf("Unassigned pid for AND-type pragma\n");
-	      exit(-1);
+	      fprintf(output, "Unassigned pid for AND-type pragma\n");
+	      fatal_error();
 	    }
 
 	  first = Pragma->pid;
@@ -433,23 +443,23 @@ void fill_tdata(char * orig_buffer, items * inputs, element * Pragma)
 
 	  if (last >= inputs->number_of_items)
 	    {
-	      printf("Internal error: didn't catch unmatched #if (first = %i, last = %i)\n", first, last);
-	      exit(-1);
+	      fprintf(output, "Internal error: didn't catch unmatched #if (first = %i, last = %i)\n", first, last);
+	      fatal_error();
 	    }
 
 	  Pragma->text_begin = inputs->data[first].begin;
 	  Pragma->text_end = inputs->data[last].begin - 1;
 	  if (Pragma->text_end < 0)
 	    {
-	      printf("Invalid pragma address: internal error\n");
-	      exit(-1);
+	      fprintf(output, "Invalid pragma address: internal error\n");
+	      fatal_error();
 	    }
 	}
       break;
 
     default:
-      printf("Incorrect pragma element type (internal error)\n");
-      exit(-1);
+      fprintf(output, "Incorrect pragma element type (internal error)\n");
+      fatal_error();
       break;
     }
 }
@@ -510,8 +520,8 @@ char * types_enum2str(pragma_type x)
       break;
 
     default:
-      printf("Invalid argument to 'types_enum2str'\n");
-      exit(-1);
+      fprintf(output, "Invalid argument to 'types_enum2str'\n");
+      fatal_error();
     }
 
   return result;
@@ -533,8 +543,8 @@ char * comp_types_enum2str(comp_type x)
       break;
 
     default:
-      printf("Invalid argument to 'comp_types_enum2str'\n");
-      exit(-1);
+      fprintf(output, "Invalid argument to 'comp_types_enum2str'\n");
+      fatal_error();
     }
 
   return result;
@@ -543,7 +553,7 @@ char * comp_types_enum2str(comp_type x)
 pragma_type get_pragma_type(char * token)
 {
   if (DEBUG_PRAGMAS)
-    printf("ptoken='%s'\n", token);
+    fprintf(output, "ptoken='%s'\n", token);
 
   if (token[0] == 0)
     return OTHER;
@@ -578,7 +588,7 @@ pragma_type get_pragma_type(char * token)
   return OTHER;
 }
 
-pragma_type extract_pragma_name(char * line)
+pragma_type extract_pragma_name(source * src, char * line)
 {
   int n, begin, end, index;
   char * token;
@@ -589,7 +599,7 @@ pragma_type extract_pragma_name(char * line)
   token = Malloc((n + 10) * sizeof(char));
 
   index = 0;
-  index = get_token(line, line, n, index, &begin, &end, token);
+  index = get_token(src, line, n, index, &begin, &end, token);
   if (index >= 0)
     result = get_pragma_type(token);
   else
@@ -599,54 +609,3 @@ pragma_type extract_pragma_name(char * line)
 
   return result;
 }
-
-int compute_VS(depth_width dw)
-{
-  int i, s;
-
-  s = 1;
-
-  for (i = 0; i < dw.depth; i++)
-    s *= dw.width;
-
-  if (DEBUG_SELECTORS)
-    {
-      printf("max depth = %i, max width = %i, number of choices = %i\n", 
-	     dw.depth, dw.width, s);
-    }
-
-  return s;
-}
-
-void create_selectors(depth_width dw, int selector, int * selectors)
-{
-  int i, n;
-  int * powers;
-
-  n = dw.depth;
-  assert(n > 0);
-
-  powers = Malloc((n + 10) * sizeof(int));
-  powers[n - 1] = dw.width;
-  for (i = n - 2; i >= 0; i--)
-    powers[i] = powers[i + 1] * dw.width;
-
-  for (i = 0; i < n; i++)
-    {
-      if (i < (n - 1))
-	selectors[i] = (selector / powers[i + 1]) % dw.width;
-      else
-	selectors[i] = selector % dw.width;
-    }
-
-  if (DEBUG_SELECTORS)
-    {
-      printf("%i: ", selector);
-      for (i = 0; i < n; i++)
-	printf("%i ", selectors[i]);
-      printf("\n");
-    }
-
-  Free(powers);
-}
-
@@ -0,0 +1,160 @@
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "adiff.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define X86_KERNELS 1
+#else
+#define X86_KERNELS 0
+#endif
+
+/* blanks are the characters diff() ignores */
+#define IS_BLANK(c) (((c) == ' ') || ((c) == '\t') || ((c) == '\n'))
+
+int (* skip_blanks)(char * buffer, int index, int n);
+
+int (* equal_prefix)(char * buffer1, char * buffer2, int n);
+
+static int skip_blanks_scalar(char * buffer, int index, int n)
+{
+  while ((index < n) && IS_BLANK(buffer[index]))
+    index++;
+
+  return index;
+}
+
+static int equal_prefix_scalar(char * buffer1, char * buffer2, int n)
+{
+  int i;
+
+  for (i = 0; i < n; i++)
+    if (buffer1[i] != buffer2[i])
+      break;
+
+  return i;
+}
+
+#if X86_KERNELS
+
+__attribute__((target("sse2")))
+static int skip_blanks_sse2(char * buffer, int index, int n)
+{
+  __m128i space, tab, newline, x, blanks;
+  unsigned int mask;
+
+  space = _mm_set1_epi8(' ');
+  tab = _mm_set1_epi8('\t');
+  newline = _mm_set1_epi8('\n');
+
+  for (; index + 16 <= n; index += 16)
+    {
+      x = _mm_loadu_si128((__m128i *) (buffer + index));
+      blanks = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, space), 
+					 _mm_cmpeq_epi8(x, tab)), 
+			    _mm_cmpeq_epi8(x, newline));
+      mask = ~_mm_movemask_epi8(blanks) & 0xffff;
+      if (mask != 0)
+	return index + __builtin_ctz(mask);
+    }
+
+  return skip_blanks_scalar(buffer, index, n);
+}
+
+__attribute__((target("sse2")))
+static int equal_prefix_sse2(char * buffer1, char * buffer2, int n)
+{
+  __m128i x1, x2;
+  unsigned int mask;
+  int i;
+
+  for (i = 0; i + 16 <= n; i += 16)
+    {
+      x1 = _mm_loadu_si128((__m128i *) (buffer1 + i));
+      x2 = _mm_loadu_si128((__m128i *) (buffer2 + i));
+      mask = ~_mm_movemask_epi8(_mm_cmpeq_epi8(x1, x2)) & 0xffff;
+      if (mask != 0)
+	return i + __builtin_ctz(mask);
+    }
+
+  return i + equal_prefix_scalar(buffer1 + i, buffer2 + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static int skip_blanks_avx2(char * buffer, int index, int n)
+{
+  __m256i space, tab, newline, x, blanks;
+  unsigned int mask;
+
+  space = _mm256_set1_epi8(' ');
+  tab = _mm256_set1_epi8('\t');
+  newline = _mm256_set1_epi8('\n');
+
+  for (; index + 32 <= n; index += 32)
+    {
+      x = _mm256_loadu_si256((__m256i *) (buffer + index));
+      blanks = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(x, space), 
+					       _mm256_cmpeq_epi8(x, tab)), 
+			       _mm256_cmpeq_epi8(x, newline));
+      mask = ~(unsigned int) _mm256_movemask_epi8(blanks);
+      if (mask != 0)
+	return index + __builtin_ctz(mask);
+    }
+
+  return skip_blanks_sse2(buffer, index, n);
+}
+
+__attribute__((target("avx2")))
+static int equal_prefix_avx2(char * buffer1, char * buffer2, int n)
+{
+  __m256i x1, x2;
+  unsigned int mask;
+  int i;
+
+  for (i = 0; i + 32 <= n; i += 32)
+    {
+      x1 = _mm256_loadu_si256((__m256i *) (buffer1 + i));
+      x2 = _mm256_loadu_si256((__m256i *) (buffer2 + i));
+      mask = ~(unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(x1, x2));
+      if (mask != 0)
+	return i + __builtin_ctz(mask);
+    }
+
+  return i + equal_prefix_sse2(buffer1 + i, buffer2 + i, n - i);
+}
+
+#endif
+
+/* must be called before any comparison, the best kernels 
+   supported by the processor are used */
+void select_kernels(void)
+{
+  skip_blanks = skip_blanks_scalar;
+  equal_prefix = equal_prefix_scalar;
+
+#if X86_KERNELS
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("sse2"))
+    {
+      skip_blanks = skip_blanks_sse2;
+      equal_prefix = equal_prefix_sse2;
+    }
+
+  if (__builtin_cpu_supports("avx2"))
+    {
+      skip_blanks = skip_blanks_avx2;
+      equal_prefix = equal_prefix_avx2;
+    }
+#endif
+
+  if (DEBUG_MISC)
+    fprintf(output, "Using %s kernels\n", 
+	    (skip_blanks == skip_blanks_scalar) ? ("scalar") : ("vector"));
+}
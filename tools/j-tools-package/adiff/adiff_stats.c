@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "adiff.h"
+
+/* "-stats": the time of each phase and a few counters, written to 
+   stderr for every pair of files; a counter costs a test of 
+   flag_stats and an increment, a phase two clock readings */
+
+extern int number_of_choices_limit;
+
+int flag_stats = 0;
+
+__thread run_stats stats;
+
+static char * phase_names[NUMBER_OF_PHASES] = 
+  {"other", "load", "scan", "pragmas", "functions", "diff", "report"};
+
+static char * counter_names[NUMBER_OF_COUNTERS] = 
+  {"files", "bytes", "tokens", "choices", "choice_space", "capped", 
+   "allocations", "hashed", "cached", "skipped", "compared"};
+
+static double now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* the thread goes on with 'phase', the time since the last switch 
+   is added to the phase before, which is returned */
+stats_phase stats_switch(stats_phase phase)
+{
+  stats_phase previous;
+  double t;
+
+  if (! flag_stats)
+    return PHASE_OTHER;
+
+  t = now();
+  if (stats.start > 0)
+    stats.time[stats.phase] += t - stats.start;
+  stats.start = t;
+
+  previous = stats.phase;
+  stats.phase = phase;
+
+  return previous;
+}
+
+/* the times are only added up when 'from' ran apart from 'into', 
+   not while 'into' was waiting for it */
+void stats_merge(run_stats * into, run_stats * from, int with_times)
+{
+  int i;
+
+  if (with_times)
+    for (i = 0; i < NUMBER_OF_PHASES; i++)
+      into->time[i] += from->time[i];
+  for (i = 0; i < NUMBER_OF_COUNTERS; i++)
+    into->count[i] += from->count[i];
+}
+
+void stats_difference(run_stats * result, run_stats * after, run_stats * before)
+{
+  int i;
+
+  for (i = 0; i < NUMBER_OF_PHASES; i++)
+    result->time[i] = after->time[i] - before->time[i];
+  for (i = 0; i < NUMBER_OF_COUNTERS; i++)
+    result->count[i] = after->count[i] - before->count[i];
+}
+
+/* one line of name=value fields, 'name2' can be NULL */
+void stats_print(FILE * f, char * name1, char * name2, run_stats * s)
+{
+  char line[8192];
+  size_t n;
+  int i;
+  double total;
+
+  total = 0;
+  for (i = 0; i < NUMBER_OF_PHASES; i++)
+    total += s->time[i];
+
+  /* n stays at the terminating 0 when snprintf truncates */
+  n = snprintf(line, sizeof(line), "STATS %s%s%s time=%.6f", 
+	       name1, (name2 != NULL) ? " " : "", (name2 != NULL) ? name2 : "", total);
+  n = MIN(n, sizeof(line) - 1);
+  for (i = 0; (i < NUMBER_OF_PHASES) && (n < sizeof(line) - 1); i++)
+    n = MIN(n + snprintf(line + n, sizeof(line) - n, " %s=%.6f", phase_names[i], s->time[i]), 
+	    sizeof(line) - 1);
+  for (i = 0; (i < NUMBER_OF_COUNTERS) && (n < sizeof(line) - 1); i++)
+    n = MIN(n + snprintf(line + n, sizeof(line) - n, " %s=%lli", counter_names[i], s->count[i]), 
+	    sizeof(line) - 1);
+  if (n < sizeof(line) - 1)
+    snprintf(line + n, sizeof(line) - n, " limit=%i", number_of_choices_limit);
+
+  /* a single write, so that the lines of threads are not mixed */
+  fprintf(f, "%s\n", line);
+}
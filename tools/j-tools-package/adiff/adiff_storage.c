@@ -5,13 +5,22 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "adiff.h"
 
 void init_items(items * Items, int max_pairs)
 {
-  Items->max_pairs = max_pairs;
+  init_items_in(Items, max_pairs, NULL);
+}
+
+void init_items_in(items * Items, int max_pairs, arena * pool)
+{
+  Items->max_pairs = MAX(max_pairs, 1);
   Items->number_of_items = 0;
-  Items->data = Malloc(Items->max_pairs * sizeof(item));
+  Items->pool = pool;
+  Items->data = Alloc(pool, Items->max_pairs * sizeof(item));
 }
 
 void free_items(items * Items)
@@ -19,25 +28,20 @@ void free_items(items * Items)
   Items->max_pairs = 0;
   Items->number_of_items = 0;
   if (Items->data != NULL)
-    Free(Items->data);
+    Release(Items->pool, Items->data);
   Items->data = NULL;
 }
 
 void add_item(items * Items, int begin, int end, pragma_type type)
 {
-  item * old_data = NULL;
-  int i;
-
   if (Items->number_of_items >= Items->max_pairs)
     {
       Items->max_pairs *= 2;
       if (DEBUG_MISC)
-	printf("Increasing number of pairs to %i\n", Items->max_pairs);
-      old_data = Items->data;
-      Items->data = Malloc(Items->max_pairs * sizeof(item));
-      for (i = 0; i < Items->number_of_items; i++)
-	Items->data[i] = old_data[i];
-      Free(old_data);
+	fprintf(output, "Increasing number of pairs to %i\n", Items->max_pairs);
+      Items->data = Grow(Items->pool, Items->data, 
+			 Items->number_of_items * sizeof(item), 
+			 Items->max_pairs * sizeof(item));
     }
 
   Items->data[Items->number_of_items].begin = begin;
@@ -46,75 +50,319 @@ void add_item(items * Items, int begin, int end, pragma_type type)
   Items->number_of_items++;
 }
 
+void init_source(source * src, char * data, int length)
+{
+  int i, max_lines;
+
+  src->data = data;
+  src->length = length;
+
+  max_lines = 1;
+  for (i = 0; i < length; i++)
+    if (data[i] == '\n')
+      max_lines++;
+
+  src->lines = Malloc(max_lines * sizeof(int));
+  src->lines[0] = 0;
+  src->num_lines = 1;
+  for (i = 0; i < length; i++)
+    if (data[i] == '\n')
+      src->lines[src->num_lines++] = i + 1;
+
+  src->cleaned = NULL;
+  src->cleaned_length = 0;
+  src->literals.data = NULL;
+}
+
+static int mapped_size(int length)
+{
+  int page;
+
+  page = sysconf(_SC_PAGESIZE);
+
+  return (length / page + 1) * page;
+}
+
+/* maps the file read-only, the mapping is always followed by zero bytes 
+   so that the data can be used as a string; NULL if the file cannot be read */
+char * map_file(char * file, int * length)
+{
+  int fd, size;
+  struct stat filestat;
+  char * data;
+
+  fd = open(file, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  if ((fstat(fd, &filestat) != 0) || (! S_ISREG(filestat.st_mode)))
+    {
+      close(fd);
+      return NULL;
+    }
+
+  *length = filestat.st_size;
+  size = mapped_size(*length);
+
+  /* anonymous pages keep the end of the mapping zero filled */
+  data = mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (data == MAP_FAILED)
+    {
+      fprintf(output, "Cannot map %i bytes of file %s\n", size, file);
+      fatal_error();
+    }
+
+  if (*length > 0)
+    if (mmap(data, *length, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)
+      {
+	fprintf(output, "Cannot map file %s\n", file);
+	fatal_error();
+      }
+
+  close(fd);
+
+  return data;
+}
+
+void unmap_file(char * data, int length)
+{
+  munmap(data, mapped_size(length));
+}
+
+void free_source(source * src)
+{
+  if (src->lines != NULL)
+    Free(src->lines);
+  src->lines = NULL;
+  src->num_lines = 0;
+  if (src->cleaned != NULL)
+    Free(src->cleaned);
+  src->cleaned = NULL;
+  free_items(&src->literals);
+}
+
+/* the first item which begins at or after 'index', items must be sorted */
+int find_item_index(items * Items, int index)
+{
+  int low, high, middle;
+
+  low = 0;
+  high = Items->number_of_items;
+  while (low < high)
+    {
+      middle = (low + high) / 2;
+      if (Items->data[middle].begin < index)
+	low = middle + 1;
+      else
+	high = middle;
+    }
+
+  return low;
+}
+
 void finit(fentries * FEntries, int max_funcs)
 {
-  FEntries->max_funcs = max_funcs;
+  finit_in(FEntries, max_funcs, NULL);
+}
+
+void finit_in(fentries * FEntries, int max_funcs, arena * pool)
+{
+  FEntries->max_funcs = MAX(max_funcs, 1);
   FEntries->num_funcs = 0;
-  FEntries->data = Malloc(FEntries->max_funcs * sizeof(fentry));
+  FEntries->pool = pool;
+  FEntries->data = Alloc(pool, FEntries->max_funcs * sizeof(fentry));
   assert(FEntries->data != NULL);
+
+  FEntries->hash_size = 16;
+  while (FEntries->hash_size < 2 * max_funcs)
+    FEntries->hash_size *= 2;
+  FEntries->hash = Alloc(pool, FEntries->hash_size * sizeof(int));
+  memset(FEntries->hash, 0, FEntries->hash_size * sizeof(int));
+}
+
+void ffree(fentries * FEntries)
+{
+  int i;
+
+  if (FEntries->pool == NULL)
+    for (i = 0; i < FEntries->num_funcs; i++)
+      Free(FEntries->data[i].fname);
+  Release(FEntries->pool, FEntries->data);
+  Release(FEntries->pool, FEntries->hash);
+  FEntries->data = NULL;
+  FEntries->hash = NULL;
+  FEntries->num_funcs = 0;
+  FEntries->max_funcs = 0;
+  FEntries->hash_size = 0;
+}
+
+unsigned int hash_name(char * name)
+{
+  unsigned int h;
+
+  h = 2166136261u;
+  for (; *name != 0; name++)
+    h = (h ^ (unsigned char) *name) * 16777619u;
+
+  return h;
+}
+
+/* only the first function with a given name is indexed, so that lookups 
+   return the same entry as a linear search from the beginning */
+static void fhash_insert(fentries * FEntries, int index)
+{
+  int mask, slot;
+
+  mask = FEntries->hash_size - 1;
+  slot = hash_name(FEntries->data[index].fname) & mask;
+  while (FEntries->hash[slot] != 0)
+    {
+      if (strcmp(FEntries->data[FEntries->hash[slot] - 1].fname, 
+		 FEntries->data[index].fname) == 0)
+	return;
+      slot = (slot + 1) & mask;
+    }
+  FEntries->hash[slot] = index + 1;
+}
+
+int ffind(fentries * FEntries, char * name)
+{
+  int mask, slot;
+
+  mask = FEntries->hash_size - 1;
+  slot = hash_name(name) & mask;
+  while (FEntries->hash[slot] != 0)
+    {
+      if (strcmp(FEntries->data[FEntries->hash[slot] - 1].fname, name) == 0)
+	return FEntries->hash[slot] - 1;
+      slot = (slot + 1) & mask;
+    }
+
+  return -1;
 }
 
 void fadd(fentries * FEntries, char * name, int begin, int end)
 {
-  fentry * old_data = NULL;
   int i;
 
   if (FEntries->num_funcs >= FEntries->max_funcs)
     {
       FEntries->max_funcs *= 2;
       if (DEBUG_MISC)
-	printf("Increasing number of functions to %i\n", FEntries->max_funcs);
-      old_data = FEntries->data;
-      FEntries->data = Malloc(FEntries->max_funcs * sizeof(fentry));
+	fprintf(output, "Increasing number of functions to %i\n", FEntries->max_funcs);
+      FEntries->data = Grow(FEntries->pool, FEntries->data, 
+			    FEntries->num_funcs * sizeof(fentry), 
+			    FEntries->max_funcs * sizeof(fentry));
+    }
+
+  if (2 * (FEntries->num_funcs + 1) > FEntries->hash_size)
+    {
+      Release(FEntries->pool, FEntries->hash);
+      FEntries->hash_size *= 2;
+      FEntries->hash = Alloc(FEntries->pool, FEntries->hash_size * sizeof(int));
+      memset(FEntries->hash, 0, FEntries->hash_size * sizeof(int));
       for (i = 0; i < FEntries->num_funcs; i++)
-	{
-	  FEntries->data[i].fname = old_data[i].fname;
-	  FEntries->data[i].fbegin = old_data[i].fbegin;
-	  FEntries->data[i].fend = old_data[i].fend;
-	}
-      Free(old_data);
+	fhash_insert(FEntries, i);
     }
 
-  FEntries->data[FEntries->num_funcs].fname = strdup(name);
+  if (FEntries->pool != NULL)
+    FEntries->data[FEntries->num_funcs].fname = arena_intern(FEntries->pool, name);
+  else
+    FEntries->data[FEntries->num_funcs].fname = strdup(name);
   assert(FEntries->data[FEntries->num_funcs].fname != NULL);
   FEntries->data[FEntries->num_funcs].fbegin = begin;
   FEntries->data[FEntries->num_funcs].fend = end;
+  FEntries->data[FEntries->num_funcs].fhash = 0;
+  FEntries->data[FEntries->num_funcs].fhashed = 0;
+  fhash_insert(FEntries, FEntries->num_funcs);
   FEntries->num_funcs++;
 }
 
-void adjust_items(items * Items, int shift, int begin, int end)
+void tinit(tentries * TEntries, int max_tokens)
 {
-  int i;
+  tinit_in(TEntries, max_tokens, NULL);
+}
 
-  for (i = 0; i < Items->number_of_items; i++)
+void tinit_in(tentries * TEntries, int max_tokens, arena * pool)
+{
+  TEntries->max_tokens = MAX(max_tokens, 1);
+  TEntries->num_tokens = 0;
+  TEntries->pool = pool;
+  TEntries->data = Alloc(pool, TEntries->max_tokens * sizeof(tentry));
+}
+
+void tadd(tentries * TEntries, int begin, int end, token_kind kind)
+{
+  if (TEntries->num_tokens >= TEntries->max_tokens)
     {
-      if ((Items->data[i].begin >= begin) || (Items->data[i].begin >= end))
-	Items->data[i].begin += shift;
-      if ((Items->data[i].end >= begin) || (Items->data[i].end >= end))
-	Items->data[i].end += shift;
+      TEntries->max_tokens *= 2;
+      TEntries->data = Grow(TEntries->pool, TEntries->data, 
+			    TEntries->num_tokens * sizeof(tentry), 
+			    TEntries->max_tokens * sizeof(tentry));
+    }
+
+  TEntries->data[TEntries->num_tokens].begin = begin;
+  TEntries->data[TEntries->num_tokens].end = end;
+  TEntries->data[TEntries->num_tokens].kind = kind;
+  TEntries->data[TEntries->num_tokens].match = -1;
+  TEntries->num_tokens++;
+}
+
+void tfree(tentries * TEntries)
+{
+  Release(TEntries->pool, TEntries->data);
+  TEntries->data = NULL;
+  TEntries->num_tokens = 0;
+  TEntries->max_tokens = 0;
+}
+
+static int compare_intervals(const void * x, const void * y)
+{
+  const finterval * a = x, * b = y;
+
+  if (a->fbegin != b->fbegin)
+    return (a->fbegin < b->fbegin) ? -1 : 1;
+  if (a->fend != b->fend)
+    return (a->fend < b->fend) ? -1 : 1;
+  return a->index - b->index;
+}
+
+/* function limits ordered by their beginning */
+finterval * create_func_intervals(fentries * functions)
+{
+  int i, n;
+  finterval * intervals;
+
+  n = functions->num_funcs;
+
+  intervals = Malloc((n + 1) * sizeof(finterval));
+  for (i = 0; i < n; i++)
+    {
+      intervals[i].fbegin = functions->data[i].fbegin;
+      intervals[i].fend = functions->data[i].fend;
+      intervals[i].index = i;
     }
+  qsort(intervals, n, sizeof(finterval), compare_intervals);
+
+  return intervals;
 }
 
-void removeItems(char * buffer, items * Items)
+void adjust_items(items * Items, int shift, int begin, int end)
 {
-  int i, j, n, begin, end;
+  int i;
 
   for (i = 0; i < Items->number_of_items; i++)
     {
-      begin =  Items->data[i].begin;
-      end =  Items->data[i].end;
-      n = strlen(buffer);
-      assert(begin < n);
-      assert(end < n);
-      for (j = end + 1; j <= n; j++)
-	buffer[begin + j - end - 1] = buffer[j];
-      adjust_items(Items, - (end - begin + 1), begin, end);
+      if ((Items->data[i].begin >= begin) || (Items->data[i].begin >= end))
+	Items->data[i].begin += shift;
+      if ((Items->data[i].end >= begin) || (Items->data[i].end >= end))
+	Items->data[i].end += shift;
     }
 }
 
 void clear(char * buffer, items * Items)
 {
-  int i, j, begin, end, n;
+  int i, begin, end, n;
 
   n = strlen(buffer);
   for (i = 0; i < Items->number_of_items; i++)
@@ -123,8 +371,8 @@ void clear(char * buffer, items * Items)
       end =  Items->data[i].end;
       assert(begin < n);
       assert(end < n);
-      for (j = begin; j <= end; j++)
-	buffer[j] = ' ';
+      if (end >= begin)
+	memset(buffer + begin, ' ', end - begin + 1);
     }
 }
 
@@ -132,24 +380,24 @@ void create_func_items(items * orig, items * new, int fbegin, int fend)
 {
   int i;
 
-  init_items(new, orig->max_pairs);
+  init_items_in(new, orig->max_pairs, orig->pool);
   for (i = 0; i < orig->number_of_items; i++)
     if ((orig->data[i].begin >= fbegin) && (orig->data[i].begin <= fend) && 
 	(orig->data[i].end >= fbegin) && (orig->data[i].end <= fend))
       add_item(new, orig->data[i].begin, orig->data[i].end, orig->data[i].type);
 }
 
-void print_functions(char * orig_buffer, fentries * functions)
+void print_functions(source * src, fentries * functions)
 {
   int i;
 
   for (i = 0; i < functions->num_funcs; i++)
     {
-      printf("Function \"%s\" [%i, %i]\n", functions->data[i].fname, 
-	     get_line_number(orig_buffer, functions->data[i].fbegin),  
-	     get_line_number(orig_buffer, functions->data[i].fend));
+      fprintf(output, "Function \"%s\" [%i, %i]\n", functions->data[i].fname, 
+	     get_line_number(src, functions->data[i].fbegin),  
+	     get_line_number(src, functions->data[i].fend));
       if (DEBUG_EXTRACTING)
-	printf("Function body limits offset [%i, %i]\n", functions->data[i].fbegin, functions->data[i].fend);
+	fprintf(output, "Function body limits offset [%i, %i]\n", functions->data[i].fbegin, functions->data[i].fend);
     }
 }
 
@@ -157,7 +405,7 @@ void copy_items_type(items * orig, items * new, pragma_type type)
 {
   int i;
 
-  init_items(new, orig->max_pairs);
+  init_items_in(new, orig->max_pairs, orig->pool);
   for (i = 0; i < orig->number_of_items; i++)
     if (orig->data[i].type == type)
       add_item(new, orig->data[i].begin, orig->data[i].end, orig->data[i].type);
@@ -167,18 +415,19 @@ void delete_items_type(items * orig, items * new, pragma_type type)
 {
   int i;
 
-  init_items(new, orig->max_pairs);
+  init_items_in(new, orig->max_pairs, orig->pool);
   for (i = 0; i < orig->number_of_items; i++)
     if (orig->data[i].type != type)
       add_item(new, orig->data[i].begin, orig->data[i].end, orig->data[i].type);
 }
 
 element * create_pragmas(int pid, int tbegin, int tend, int pbegin, 
-			 int pend, comp_type type, int max_elements)
+			 int pend, comp_type type, int max_elements, arena * pool)
 {
   element * Element;
 
-  Element = Malloc(sizeof(element));
+  Element = Alloc(pool, sizeof(element));
+  Element->pool = pool;
 
   Element->max_elements = max_elements;
   Element->number_of_elements = 0;
@@ -188,15 +437,20 @@ element * create_pragmas(int pid, int tbegin, int tend, int pbegin,
   Element->pragma_begin = pbegin;
   Element->pragma_end = pend;
   Element->pid = pid;
-  Element->list = Malloc(Element->max_elements * sizeof(element *));
+  Element->number_of_choices = 1;
+  Element->list = Alloc(pool, Element->max_elements * sizeof(element *));
   
   return Element;
 }
 
+/* the pragmas in an arena go away with it */
 void free_pragmas(element * Element)
 {
   int i;
 
+  if (Element->pool != NULL)
+    return;
+
   for (i = 0; i < Element->number_of_elements; i++)
     free_pragmas(Element->list[i]);
 
@@ -211,19 +465,14 @@ void free_pragmas(element * Element)
 
 void add_pragma(element * Element, element * subelement)
 {
-  struct element * * old_list = NULL;
-  int i;
-
   if (Element->number_of_elements >= Element->max_elements)
     {
       Element->max_elements *= 2;
       if (DEBUG_MISC)
-	printf("Increasing number of elements to %i\n", Element->max_elements);
-      old_list = Element->list;
-      Element->list = Malloc(Element->max_elements * sizeof(element *));
-      for (i = 0; i < Element->number_of_elements; i++)
-	Element->list[i] = old_list[i];
-      Free(old_list);
+	fprintf(output, "Increasing number of elements to %i\n", Element->max_elements);
+      Element->list = Grow(Element->pool, Element->list, 
+			   Element->number_of_elements * sizeof(element *), 
+			   Element->max_elements * sizeof(element *));
     }
 
   Element->list[Element->number_of_elements] = subelement;
@@ -237,12 +486,32 @@ void * Malloc(int size)
 
   n = (HUGE_ALLOCATE) ? (HUGE_MEM) : (size);
 
+  STATS_ADD(COUNT_ALLOCATIONS, 1);
   p = malloc(n);
 
   if (p == NULL)
     {
-      printf("Cannot allocate %lf MB of memory\n", n / 1024.0 / 1024.0);
-      exit(-1);
+      fprintf(output, "Cannot allocate %lf MB of memory\n", n / 1024.0 / 1024.0);
+      fatal_error();
+    }
+
+  return p;
+}
+
+void * Realloc(void * data, int size)
+{
+  int n;
+  void * p;
+
+  n = (HUGE_ALLOCATE) ? (HUGE_MEM) : (size);
+
+  STATS_ADD(COUNT_ALLOCATIONS, 1);
+  p = realloc(data, n);
+
+  if (p == NULL)
+    {
+      fprintf(output, "Cannot allocate %lf MB of memory\n", n / 1024.0 / 1024.0);
+      fatal_error();
     }
 
   return p;
@@ -254,49 +523,49 @@ void Free(void * data)
     free(data);
 }
 
-void print_items(char * orig_buffer, items * Items)
+void print_items(source * src, items * Items)
 {
   int i, j;
 
   for (i = 0; i < Items->number_of_items; i++)
     {
-      printf("Item \n\t");
+      fprintf(output, "Item \n\t");
       for (j = Items->data[i].begin; j <= Items->data[i].end; j++)
-	printf("%c", orig_buffer[j]);
-      printf("of type \"%s\" at lines [%i, %i]\n", types_enum2str(Items->data[i].type), 
-	     get_line_number(orig_buffer, Items->data[i].begin),  
-	     get_line_number(orig_buffer, Items->data[i].end));
+	fprintf(output, "%c", src->data[j]);
+      fprintf(output, "of type \"%s\" at lines [%i, %i]\n", types_enum2str(Items->data[i].type), 
+	     get_line_number(src, Items->data[i].begin),  
+	     get_line_number(src, Items->data[i].end));
     }
 }
 
-void print_pragmas(char * orig_buffer, element * Element, int indent)
+void print_pragmas(source * src, element * Element, int indent)
 {
   int i, j, n;
 
   n = Element->number_of_elements;
 
   for (j = 0; j < indent; j++)
-    printf(" ");
+    fprintf(output, " ");
 
-  printf("Element %i of type '%s' has pragma with data \"", 
+  fprintf(output, "Element %i of type '%s' has pragma with data \"", 
 	 Element->pid, 
 	 comp_types_enum2str(Element->type));
 
   for (j = Element->pragma_begin; j <= Element->pragma_end; j++)
-    printf("%c", orig_buffer[j] != '\n' ? orig_buffer[j] : ' ');
+    fprintf(output, "%c", src->data[j] != '\n' ? src->data[j] : ' ');
 
-  printf("\" at lines [%i (%i), %i (%i)] and contains text in lines [%i (%i), %i (%i)]\n", 
-	 get_line_number(orig_buffer, Element->pragma_begin), 
+  fprintf(output, "\" at lines [%i (%i), %i (%i)] and contains text in lines [%i (%i), %i (%i)]\n", 
+	 get_line_number(src, Element->pragma_begin), 
 	 Element->pragma_begin, 
-	 get_line_number(orig_buffer, Element->pragma_end), 
+	 get_line_number(src, Element->pragma_end), 
 	 Element->pragma_end, 
-	 get_line_number(orig_buffer, Element->text_begin), 
+	 get_line_number(src, Element->text_begin), 
 	 Element->text_begin, 
-	 get_line_number(orig_buffer, Element->text_end), 
+	 get_line_number(src, Element->text_end), 
 	 Element->text_end);
 
   for (i = 0; i < n; i++)
-    print_pragmas(orig_buffer, Element->list[i], indent + 1);
+    print_pragmas(src, Element->list[i], indent + 1);
 }
 
 void create_items_from_functions(items * fitems, fentries * functions)
@@ -305,7 +574,7 @@ void create_items_from_functions(items * fitems, fentries * functions)
 
   n = functions->num_funcs;
 
-  init_items(fitems, n);
+  init_items_in(fitems, n, functions->pool);
 
   for (i = 0; i < n; i++)
     add_item(fitems, functions->data[i].fbegin, functions->data[i].fend, OTHER);
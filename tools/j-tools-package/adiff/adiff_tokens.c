@@ -10,7 +10,7 @@
 
 extern int flag_find_full_function;
 
-extern char error_message[1024];
+extern __thread char error_message[1024];
 
 int is_delimiter(char c)
 {
@@ -39,8 +39,8 @@ int skip_spaces(char * buffer, int index)
   return index;
 }
 
-int get_simple_token(char * orig_buffer, char * buffer, int n, int index, 
-		     int * begin, int * end, char * token)
+int get_simple_token_limits(char * buffer, int n, int index, 
+			    int * begin, int * end)
 {
   if ((index < 0) || (index >= n))
     return -1;
@@ -67,14 +67,25 @@ int get_simple_token(char * orig_buffer, char * buffer, int n, int index,
       *end = index - 1;
     }
   
-  strncpy(token, buffer + (*begin), (*end) - (*begin) + 1); /* ??? + 2 or + 1 ??? */
-  token[(*end) - (*begin) + 1] = 0;
-
   index = skip_spaces(buffer, (*end) + 1);
   
   return index;
 }
 
+int get_simple_token(source * src, char * buffer, int n, int index, 
+		     int * begin, int * end, char * token)
+{
+  index = get_simple_token_limits(buffer, n, index, begin, end);
+
+  if (index < 0)
+    return -1;
+
+  strncpy(token, buffer + (*begin), (*end) - (*begin) + 1);
+  token[(*end) - (*begin) + 1] = 0;
+
+  return index;
+}
+
 int compatible_tokens(char * token1, char * token2)
 {
   char c1, c2;
@@ -155,71 +166,260 @@ int compatible_tokens(char * token1, char * token2)
   return 0;
 }
 
-int get_token(char * orig_buffer, char * buffer, int n, int index, 
+/* compatible_tokens only looks at the first two characters of each token */
+static void short_token(char * buffer, int begin, int end, char * token)
+{
+  token[0] = buffer[begin];
+  token[1] = (end > begin) ? (buffer[begin + 1]) : (0);
+  token[2] = 0;
+}
+
+/* the two simple tokens which can form one token: 
+   'index1' follows the first one, which was searched from 'index' */
+static int merge_tokens(char * buffer, int index, int index1, 
+			int begin1, int end1, int begin2, int end2)
+{
+  char token1[3], token2[3];
+  int special_case_flag;
+
+  short_token(buffer, begin1, end1, token1);
+  short_token(buffer, begin2, end2, token2);
+
+  special_case_flag = 0;
+  if (allow_space_in_pragma_name)
+    if (token1[0] == '#')
+      if (token1[1] == 0)
+	special_case_flag = 1;
+      
+  if ((index + (end1 - begin1 + 1) != index1) && (! special_case_flag))
+    return 0;
+
+  return compatible_tokens(token1, token2);
+}
+
+/* same as get_token, but only the limits of the token are returned:
+   '*second' is the beginning of the second part of a merged token 
+   (the first part is always one character long) or -1 */
+int get_token_limits(char * buffer, int n, int index, 
+		     int * begin, int * end, int * second)
+{
+  int index1, index2, begin1, end1, begin2, end2;
+
+  *second = -1;
+
+  index1 = get_simple_token_limits(buffer, n, index, &begin1, &end1);
+  if (index1 < 0)
+    return -1;
+
+  *begin = begin1;
+  *end = end1;
+
+  index2 = get_simple_token_limits(buffer, n, index1, &begin2, &end2);
+  if (index2 < 0)
+    return index1;
+
+  if (merge_tokens(buffer, index, index1, begin1, end1, begin2, end2))
+    {
+      *end = end2;
+      *second = begin2;
+      return index2;
+    }
+
+  return index1;
+}
+
+/* token text is written to 'token' */
+int get_token(source * src, char * buffer, int n, int index, 
 	      int * begin, int * end, char * token)
 {
-  int old_index, index1, index2, i, n1, n2, 
-    begin1, end1, begin2, end2, special_case_flag;
-  char * ptr1, * ptr2;
+  int second, length;
+
+  index = get_token_limits(buffer, n, index, begin, end, &second);
 
-  while (1)
+  if (index >= 0)
     {
-      ptr1 = token;
-      old_index = index;
-      index1 = get_simple_token(orig_buffer, buffer, n, index, &begin1, &end1, ptr1);
-      *begin = begin1;
-      *end = end1;
-      if (index1 < 0)
+      if (second < 0)
 	{
-	  index = -1;
-	  break;
+	  length = (*end) - (*begin) + 1;
+	  strncpy(token, buffer + (*begin), length);
 	}
-      ptr2 = token + strlen(token) + 1;
-      index2 = get_simple_token(orig_buffer, buffer, n, index1, &begin2, &end2, ptr2);
+      else
+	{
+	  token[0] = buffer[*begin];
+	  length = (*end) - second + 2;
+	  strncpy(token + 1, buffer + second, length - 1);
+	}
+      token[length] = 0;
+    }
 
-      if (index2 < 0)
+  if (DEBUG_TOKENS)
+    if (index >= 0)
+      fprintf(output, "Token '%s' at line %i\n", token, get_line_number(src, index));
+
+  return index;
+}
+
+/* compares the token found by get_token_limits with 'target' */
+int token_equal(char * buffer, int begin, int end, int second, char * target)
+{
+  int length;
+
+  length = strlen(target);
+
+  if (second < 0)
+    return ((end - begin + 1 == length) && 
+	    (strncmp(buffer + begin, target, length) == 0));
+
+  return ((end - second + 2 == length) && 
+	  (buffer[begin] == target[0]) && 
+	  (strncmp(buffer + second, target + 1, length - 1) == 0));
+}
+
+static token_kind get_token_kind(char * buffer, int begin, int second)
+{
+  if (second >= 0)
+    return TOKEN_OTHER;
+
+  if (! is_delimiter(buffer[begin]))
+    return TOKEN_IDENTIFIER;
+
+  switch (buffer[begin])
+    {
+    case '(':
+      return TOKEN_OPEN_PAREN;
+    case ')':
+      return TOKEN_CLOSE_PAREN;
+    case '[':
+      return TOKEN_OPEN_SQUARE;
+    case ']':
+      return TOKEN_CLOSE_SQUARE;
+    case '{':
+      return TOKEN_OPEN_CURLY;
+    case '}':
+      return TOKEN_CLOSE_CURLY;
+    case ';':
+      return TOKEN_SEMICOLON;
+    case ',':
+      return TOKEN_COMMA;
+    default:
+      return TOKEN_OTHER;
+    }
+}
+
+/* every bracket kind is matched separately, as match_bracket does */
+static void match_brackets(tentries * tokens)
+{
+  int i, k, n;
+  int * stack[3];
+  int top[3];
+
+  n = tokens->num_tokens;
+
+  for (k = 0; k < 3; k++)
+    {
+      stack[k] = Alloc(tokens->pool, (n + 1) * sizeof(int));
+      top[k] = 0;
+    }
+
+  for (i = 0; i < n; i++)
+    {
+      tokens->data[i].match = -1;
+
+      switch (tokens->data[i].kind)
 	{
-	  index = index1;
+	case TOKEN_OPEN_PAREN:
+	case TOKEN_OPEN_SQUARE:
+	case TOKEN_OPEN_CURLY:
+	  k = (tokens->data[i].kind - TOKEN_OPEN_PAREN) / 2;
+	  stack[k][top[k]++] = i;
+	  break;
+
+	case TOKEN_CLOSE_PAREN:
+	case TOKEN_CLOSE_SQUARE:
+	case TOKEN_CLOSE_CURLY:
+	  k = (tokens->data[i].kind - TOKEN_OPEN_PAREN) / 2;
+	  if (top[k] > 0)
+	    {
+	      top[k]--;
+	      tokens->data[stack[k][top[k]]].match = i;
+	      tokens->data[i].match = stack[k][top[k]];
+	    }
+	  break;
+
+	default:
 	  break;
 	}
-      
-      special_case_flag = 0;
-      if (allow_space_in_pragma_name)
-	if (ptr1[0] == '#')
-	  if (ptr1[1] == 0)
-	    special_case_flag = 1;
-      
-      if ((index + strlen(ptr1) != index1) && (! special_case_flag))
+    }
+
+  for (k = 0; k < 3; k++)
+    Release(tokens->pool, stack[k]);
+}
+
+/* splits the whole buffer into tokens, the same as successive calls 
+   of get_token would do, each simple token is scanned only once, 
+   the tokens are kept in 'pool' if it is set */
+void tokenize(source * src, char * buffer, tentries * tokens, arena * pool)
+{
+  int n, index, index1, index2, begin1, end1, begin2, end2;
+
+  n = strlen(buffer);
+
+  tinit_in(tokens, n / 4 + 10, pool);
+
+  index = 0;
+  index1 = get_simple_token_limits(buffer, n, index, &begin1, &end1);
+
+  while (index1 >= 0)
+    {
+      index2 = get_simple_token_limits(buffer, n, index1, &begin2, &end2);
+
+      if (index2 < 0)
 	{
-	  index = index1;
+	  tadd(tokens, begin1, end1, get_token_kind(buffer, begin1, -1));
 	  break;
 	}
-      
-      if (compatible_tokens(ptr1, ptr2))
+
+      if (merge_tokens(buffer, index, index1, begin1, end1, begin2, end2))
 	{
-	  n1 = strlen(ptr1);
-	  n2 = strlen(ptr2);
-	  for (i = 0; i <= n2; i++)
-	    ptr1[n1 + i] = ptr2[i];
-	  *begin = begin1;
-	  *end = end2;
+	  tadd(tokens, begin1, end2, TOKEN_OTHER);
 	  index = index2;
-	  break;
+	  index1 = get_simple_token_limits(buffer, n, index, &begin1, &end1);
 	}
       else
 	{
+	  tadd(tokens, begin1, end1, get_token_kind(buffer, begin1, -1));
 	  index = index1;
-	  break;
+	  index1 = index2;
+	  begin1 = begin2;
+	  end1 = end2;
 	}
-
-      break;
     }
 
+  match_brackets(tokens);
+  STATS_ADD(COUNT_TOKENS, tokens->num_tokens);
+
   if (DEBUG_TOKENS)
-    if (index >= 0)
-      printf("Token '%s' at line %i\n", token, get_line_number(orig_buffer, index));
+    fprintf(output, "%i tokens in %i characters (line %i)\n", tokens->num_tokens, n, 
+	   get_line_number(src, 0));
+}
 
-  return index;
+/* the first token which begins at or after 'index' */
+int find_token_index(tentries * tokens, int index)
+{
+  int low, high, middle;
+
+  low = 0;
+  high = tokens->num_tokens;
+  while (low < high)
+    {
+      middle = (low + high) / 2;
+      if (tokens->data[middle].begin < index)
+	low = middle + 1;
+      else
+	high = middle;
+    }
+
+  return low;
 }
 
 int is_identifier(char * token)
@@ -234,38 +434,26 @@ int is_identifier(char * token)
   return 1;
 }
 
-int find_token(char * orig_buffer, char * buffer, int n, int index, char * target)
+int find_token(source * src, char * buffer, int n, int index, char * target)
 {
-  int counter, begin, end;
-  char * token;
-
-  token = malloc((n + 10) * sizeof(char));
-  assert(token != NULL);
+  int begin, end, second;
 
   do
     {
-      index = get_token(orig_buffer, buffer, n, index, &begin, &end, token);
+      index = get_token_limits(buffer, n, index, &begin, &end, &second);
 
       if (index < 0)
-	{
-	  Free(token);
-	  return -1;
-	}
+	return -1;
 
       if (DEBUG_FUNC_TOKENS)
-	printf("Checking tokens in function body \"%s\" [%i:%i]\n", 
-	       token, index, get_line_number(orig_buffer, index));
+	fprintf(output, "Checking tokens in function body [%i:%i]\n", 
+	       index, get_line_number(src, index));
 
-      if (strcmp(token, target) == 0)
-	{
-	  Free(token);
-	  return begin;
-	}
+      if (token_equal(buffer, begin, end, second, target))
+	return begin;
 
     } while (1);
 
-  Free(token);
-
   return -1; /* should never be reached */
 }
 
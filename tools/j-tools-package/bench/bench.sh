@@ -0,0 +1,75 @@
+#!/bin/sh
+# runs the benchmarks of adiff and the fault matrix tools on synthetic
+# inputs and writes one line per benchmark
+#
+#   <benchmark> <parameters> <runs> <min> <median> <max>
+#
+# separated by tabs, the times in seconds.  The parameters are given
+# as name=value arguments, with the defaults below; the results of two
+# runs are compared with "bench_compare.sh <baseline> <results>"
+
+runs=5
+functions=2000
+statements=10
+comments=20
+literals=10
+pragmas=10
+depth=3
+width=3
+changed=10
+tests=2000
+faults=500
+density=5
+seed=1
+threads=`getconf _NPROCESSORS_ONLN`
+data=bench_data
+output=bench.out
+
+for arg in "$@"
+do
+    case ${arg} in
+	runs=*|functions=*|statements=*|comments=*|literals=*|pragmas=*|\
+	depth=*|width=*|changed=*|tests=*|faults=*|density=*|seed=*|\
+	threads=*|data=*|output=*)
+	    eval "${arg}" ;;
+	*)
+	    echo "Usage: ${0} [<name>=<value>]..., see ${0} for the names"
+	    exit 1 ;;
+    esac
+done
+
+gen_fault_matrix=../gen_fault_matrix
+adiff=../adiff
+
+rm -rf ${data}
+mkdir -p ${data}
+
+source_params="functions=${functions},statements=${statements},comments=${comments},literals=${literals},pragmas=${pragmas},depth=${depth},width=${width},changed=${changed},threads=${threads}"
+matrix_params="tests=${tests},faults=${faults},density=${density}"
+
+./gen_bench_source ${functions} -statements=${statements} \
+    -comments=${comments} -literals=${literals} -pragmas=${pragmas} \
+    -depth=${depth} -width=${width} -seed=${seed} > ${data}/v1.c
+./gen_bench_source ${functions} -statements=${statements} \
+    -comments=${comments} -literals=${literals} -pragmas=${pragmas} \
+    -depth=${depth} -width=${width} -seed=${seed} \
+    -changed=${changed} > ${data}/v2.c
+./gen_bench_matrix ${tests} ${faults} ${data}/matrix -density=${density} \
+    -seed=${seed} -binary=${data}/matrix.bin -records=${data}/records \
+    -universe=${data}/universe
+
+(
+    printf "# benchmark\tparameters\truns\tmin\tmedian\tmax\n"
+    ./bench_adiff ${data}/v1.c ${data}/v2.c ${runs} ${source_params} \
+	-threads=${threads}
+    ./bench_time adiff ${source_params} ${runs} \
+	"${adiff}/adiff ${data}/v1.c ${data}/v2.c -threads=${threads}"
+    ./bench_matrix ${data}/matrix ${runs} read_matrix_text ${matrix_params}
+    ./bench_matrix ${data}/matrix.bin ${runs} read_matrix_binary ${matrix_params}
+    ./bench_time combine_fault_data ${matrix_params} ${runs} \
+	"${gen_fault_matrix}/combine_fault_data ${data}/records ${data}/universe ${data}/combined"
+    ./bench_time get_fault_matrix_stats ${matrix_params} ${runs} \
+	"${gen_fault_matrix}/get_fault_matrix_stats ${data}/matrix.bin"
+    ./bench_time get_fault_matrix_stats_minimal ${matrix_params} ${runs} \
+	"${gen_fault_matrix}/get_fault_matrix_stats ${data}/matrix.bin -minimal -threads=${threads}"
+) | tee ${output}
@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "adiff.h"
+#include "bench_utils.h"
+
+/* times find_functions on the first file and compare_functions on the
+   two files, with the options of adiff; linked with the objects of
+   adiff and its main program renamed */
+
+extern int flag_print_all_funcs;
+extern int flag_find_full_function;
+extern int flag_nested_comments;
+extern int number_of_choices_limit;
+extern int number_of_threads;
+
+static void time_find_functions(char * file, int runs, char * params)
+{
+  double * times;
+  double start;
+  char * buffer;
+  int i, n;
+  source src;
+  fentries functions;
+  arena pool;
+
+  times = Malloc((runs > 0 ? runs : 1) * sizeof(double));
+  buffer = map_file(file, &n);
+  if (buffer == NULL)
+    {
+      printf("Cannot open file %s for reading\n", file);
+      exit(-1);
+    }
+
+  for (i = 0; i < runs; i++)
+    {
+      arena_init(&pool, 64 * 1024);
+      finit_in(&functions, 100, &pool);
+      start = bench_now();
+      init_source(&src, buffer, n);
+      find_functions(&src, &functions);
+      free_source(&src);
+      times[i] = bench_now() - start;
+      arena_free(&pool);
+    }
+
+  unmap_file(buffer, n);
+  bench_report("find_functions", params, times, runs);
+  Free(times);
+}
+
+static void time_compare_functions(char * file1, char * file2, int runs, char * params)
+{
+  double * times;
+  double start;
+  int i;
+
+  times = Malloc((runs > 0 ? runs : 1) * sizeof(double));
+  for (i = 0; i < runs; i++)
+    {
+      start = bench_now();
+      compare_functions(file1, file2);
+      times[i] = bench_now() - start;
+    }
+
+  bench_report("compare_functions", params, times, runs);
+  Free(times);
+}
+
+int main(int argc, char * * argv)
+{
+  int i, runs;
+
+  if (argc < 5)
+    {
+      printf("%s <input1> <input2> <runs> <parameters> [-vs=<n>] [-threads=<n>]\n", argv[0]);
+      exit(-1);
+    }
+
+  output = fopen("/dev/null", "w");
+  if (output == NULL)
+    {
+      printf("Cannot open /dev/null for writing\n");
+      exit(-1);
+    }
+
+  select_kernels();
+
+  flag_print_all_funcs = 0;
+  flag_find_full_function = 1;
+  flag_nested_comments = 1;
+  number_of_choices_limit = 500;
+  number_of_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  for (i = 5; i < argc; i++)
+    {
+      if (strncmp(argv[i], "-vs=", 4) == 0)
+	sscanf(argv[i], "-vs=%i", &number_of_choices_limit);
+      else if (strncmp(argv[i], "-threads=", 9) == 0)
+	sscanf(argv[i], "-threads=%i", &number_of_threads);
+      else
+	{
+	  printf("Invalid argument %s\n", argv[i]);
+	  exit(-1);
+	}
+    }
+
+  runs = atoi(argv[3]);
+  time_find_functions(argv[1], runs, argv[4]);
+  time_compare_functions(argv[1], argv[2], runs, argv[4]);
+
+  fclose(output);
+
+  return 0;
+}
@@ -0,0 +1,19 @@
+#!/bin/sh
+# compares the medians of two runs of bench.sh, a ratio below 1 is
+# a speedup of the results over the baseline
+
+if test $# -ne 2
+then echo "Usage: ${0} <baseline> <results>"
+     exit 1
+fi
+
+awk -F'\t' '
+/^#/ {next}
+FNR == NR {baseline[$1 "\t" $2] = $5; next}
+{
+  key = $1 "\t" $2
+  if (key in baseline && baseline[key] > 0)
+    printf "%s\t%s\t%.6f\t%.6f\t%.3f\n", $1, $2, baseline[key], $5, $5 / baseline[key]
+  else
+    printf "%s\t%s\t-\t%.6f\t-\n", $1, $2, $5
+}' ${1} ${2}
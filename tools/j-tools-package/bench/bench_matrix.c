@@ -0,0 +1,44 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "defs.h"
+#include "bench_utils.h"
+
+/* times reading a fault matrix with fm_read, text or binary */
+
+int main(int argc, char * * argv)
+{
+  fault_matrix fm;
+  double * times;
+  double start;
+  int i, runs;
+
+  if (argc < 5)
+    {
+      printf("%s <matrix> <runs> <benchmark name> <parameters>\n", argv[0]);
+      exit(-1);
+    }
+
+  runs = atoi(argv[2]);
+  times = malloc((runs > 0 ? runs : 1) * sizeof(double));
+  if (times == NULL)
+    {
+      printf("Cannot allocate memory for %i runs\n", runs);
+      exit(-1);
+    }
+
+  for (i = 0; i < runs; i++)
+    {
+      fm_init(&fm);
+      start = bench_now();
+      if (! fm_read(&fm, argv[1]))
+	exit(-1);
+      times[i] = bench_now() - start;
+      fm_free(&fm);
+    }
+
+  bench_report(argv[3], argv[4], times, runs);
+  free(times);
+
+  return 0;
+}
@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "bench_utils.h"
+
+/* times a whole command, run by /bin/sh with its output thrown away */
+
+static int run(char * command)
+{
+  pid_t pid;
+  int status, fd;
+
+  pid = fork();
+  if (pid < 0)
+    return -1;
+  if (pid == 0)
+    {
+      fd = open("/dev/null", O_WRONLY);
+      if (fd >= 0)
+	dup2(fd, 1);
+      execl("/bin/sh", "sh", "-c", command, (char *) NULL);
+      _exit(127);
+    }
+  if (waitpid(pid, &status, 0) < 0)
+    return -1;
+
+  return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+int main(int argc, char * * argv)
+{
+  double * times;
+  double start;
+  int i, runs, status;
+
+  if (argc != 5)
+    {
+      printf("%s <benchmark name> <parameters> <runs> <command>\n", argv[0]);
+      exit(-1);
+    }
+
+  runs = atoi(argv[3]);
+  times = malloc((runs > 0 ? runs : 1) * sizeof(double));
+  if (times == NULL)
+    {
+      printf("Cannot allocate memory for %i runs\n", runs);
+      exit(-1);
+    }
+
+  for (i = 0; i < runs; i++)
+    {
+      start = bench_now();
+      status = run(argv[4]);
+      times[i] = bench_now() - start;
+      if (status != 0)
+	{
+	  fprintf(stderr, "%s exited with %i\n", argv[4], status);
+	  exit(-1);
+	}
+    }
+
+  bench_report(argv[1], argv[2], times, runs);
+  free(times);
+
+  return 0;
+}
@@ -0,0 +1,38 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "bench_utils.h"
+
+/* wall clock time in seconds */
+double bench_now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int compare_times(const void * a, const void * b)
+{
+  double x = *(const double *) a, y = *(const double *) b;
+
+  return (x < y) ? -1 : (x > y);
+}
+
+/* sorts 'times' and prints their minimum, median and maximum */
+void bench_report(char * name, char * params, double * times, int runs)
+{
+  double median;
+
+  if (runs <= 0)
+    return;
+
+  qsort(times, runs, sizeof(double), compare_times);
+  median = (runs % 2) ? times[runs / 2]
+    : (times[runs / 2 - 1] + times[runs / 2]) / 2;
+
+  printf("%s\t%s\t%i\t%.6f\t%.6f\t%.6f\n", name, params, runs,
+	 times[0], median, times[runs - 1]);
+  fflush(stdout);
+}
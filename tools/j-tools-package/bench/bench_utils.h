@@ -0,0 +1,13 @@
+#ifndef BENCH_UTILS_H
+#define BENCH_UTILS_H
+
+/* timing of the benchmarks; every benchmark reports one line
+
+     <benchmark> <parameters> <runs> <min> <median> <max>
+
+   separated by tabs, the times in seconds */
+
+double bench_now(void);
+void bench_report(char * name, char * params, double * times, int runs);
+
+#endif
@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "defs.h"
+
+/* writes a synthetic fault matrix of <tests> tests and <faults>
+   faults for the benchmarks of the fault matrix tools, each test
+   exposing each fault with a probability of -density=<percent>.
+   -binary=<file> also writes it as a binary matrix, and
+   -records=<file> -universe=<file> write the Version/Test/Exposed
+   records and the universe combine_fault_data builds it from.  The
+   matrix only depends on the parameters and -seed=<n> */
+
+static unsigned long long state;
+
+static int next_random(int n)
+{
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+
+  return (int) ((state >> 11) % n);
+}
+
+static void usage(char * name)
+{
+  printf("%s <tests> <faults> <matrix> [-density=<percent>] [-seed=<n>] [-binary=<file>] [-records=<file> -universe=<file>]\n", name);
+  exit(-1);
+}
+
+int main(int argc, char * * argv)
+{
+  fault_matrix fm;
+  char * * lines;
+  char * binary_file, * records_file, * universe_file;
+  char line[64];
+  int i, t, v, tests, faults, density, seed;
+  FILE * records, * universe;
+
+  if (argc < 4)
+    usage(argv[0]);
+
+  tests = atoi(argv[1]);
+  faults = atoi(argv[2]);
+  density = 5;
+  seed = 1;
+  binary_file = NULL;
+  records_file = NULL;
+  universe_file = NULL;
+  for (i = 4; i < argc; i++)
+    {
+      if (strncmp(argv[i], "-density=", 9) == 0)
+	sscanf(argv[i], "-density=%i", &density);
+      else if (strncmp(argv[i], "-seed=", 6) == 0)
+	sscanf(argv[i], "-seed=%i", &seed);
+      else if (strncmp(argv[i], "-binary=", 8) == 0)
+	binary_file = argv[i] + 8;
+      else if (strncmp(argv[i], "-records=", 9) == 0)
+	records_file = argv[i] + 9;
+      else if (strncmp(argv[i], "-universe=", 10) == 0)
+	universe_file = argv[i] + 10;
+      else
+	{
+	  printf("Invalid argument %s\n", argv[i]);
+	  usage(argv[0]);
+	}
+    }
+  if ((tests < 1) || (faults < 1)
+      || ((records_file == NULL) != (universe_file == NULL)))
+    usage(argv[0]);
+
+  lines = malloc(tests * sizeof(char *));
+  if (lines == NULL)
+    {
+      printf("Cannot allocate memory for %i tests\n", tests);
+      exit(-1);
+    }
+  for (t = 0; t < tests; t++)
+    {
+      sprintf(line, "-P bench%i input%i\n", t, t);
+      lines[t] = strdup(line);
+    }
+
+  fm_init(&fm);
+  if (! fm_resize(&fm, tests, faults, lines))
+    exit(-1);
+
+  records = NULL;
+  universe = NULL;
+  if (records_file != NULL)
+    {
+      records = fopen(records_file, "w");
+      universe = fopen(universe_file, "w");
+      if ((records == NULL) || (universe == NULL))
+	{
+	  printf("Cannot open files %s and %s for writing\n", records_file, universe_file);
+	  exit(-1);
+	}
+      for (t = 0; t < tests; t++)
+	fputs(lines[t], universe);
+      fclose(universe);
+    }
+
+  state = 88172645463325252ULL ^ (unsigned long long) seed * 2654435761ULL;
+  for (v = 1; v <= faults; v++)
+    for (t = 0; t < tests; t++)
+      {
+	i = (next_random(100) < density);
+	if (i)
+	  fm_set_exposed(&fm, t, v, 1);
+	if (records != NULL)
+	  fprintf(records, "Version:%i Test:%i Exposed:%i\n", v, t, i);
+      }
+  if (records != NULL)
+    fclose(records);
+
+  if (! fm_write_text(&fm, argv[3]))
+    exit(-1);
+  if ((binary_file != NULL) && ! fm_write_binary(&fm, binary_file))
+    exit(-1);
+
+  fm_free(&fm);
+  for (t = 0; t < tests; t++)
+    free(lines[t]);
+  free(lines);
+
+  return 0;
+}
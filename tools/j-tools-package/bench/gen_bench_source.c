@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* writes a synthetic C file for the adiff benchmarks: <functions>
+   functions of -statements=<n> statements each, with comments after
+   -comments=<percent> of the statements and string literals holding
+   comment and quote characters in -literals=<percent> of them.  Every
+   -pragmas=<n>th function has a block of #if/#elif/#else nested
+   -depth=<n> deep with -width=<n> branches at each level, which is
+   what makes the pragma choices of adiff grow.
+
+   The file only depends on the parameters and -seed=<n>; with
+   -changed=<percent> about that many functions get another constant,
+   the same functions for the same seed, so that a file and its
+   changed version make a pair to diff */
+
+static unsigned long long state;
+
+/* xorshift, so that the files are the same on every platform */
+static int next_random(unsigned long long * s, int n)
+{
+  *s ^= *s << 13;
+  *s ^= *s >> 7;
+  *s ^= *s << 17;
+
+  return (int) ((*s >> 11) % n);
+}
+
+static int statements, comments, literals, depth, width;
+
+static void statement(int f, int i, int changed)
+{
+  if (next_random(&state, 100) < literals)
+    printf("  printf(\"f%i s%i: /* %%i */ \\\"%%s\\\" '\\n'\", x, \"//\");\n", f, i);
+  else
+    printf("  x = x * %i + (y ^ %i);\n", (i == 0 && changed) ? 7 : 3, i);
+
+  if (next_random(&state, 100) < comments)
+    {
+      if (next_random(&state, 2))
+	printf("  /* statement %i of function %i,\n     about \"x\" and 'y' */\n", i, f);
+      else
+	printf("  // statement %i of function %i: x = \"/*\"\n", i, f);
+    }
+}
+
+/* a block of 'level' nested conditionals, the first branch of each
+   holds the next level */
+static void conditionals(int f, int level, char * name)
+{
+  char branch[256];
+  int j;
+
+  for (j = 0; j < width; j++)
+    {
+      sprintf(branch, "%s_%i", name, j);
+      printf("#%s defined(BENCH_%s)\n", (j == 0) ? "if" : "elif", branch);
+      printf("  x += %i;\n", j);
+      if ((j == 0) && (level > 1) && (strlen(branch) < 200))
+	conditionals(f, level - 1, branch);
+    }
+  printf("#else\n  x -= %i;\n#endif\n", level);
+}
+
+static void usage(char * name)
+{
+  printf("%s <functions> [-statements=<n>] [-comments=<percent>] [-literals=<percent>] [-pragmas=<n>] [-depth=<n>] [-width=<n>] [-seed=<n>] [-changed=<percent>]\n", name);
+  exit(-1);
+}
+
+int main(int argc, char * * argv)
+{
+  unsigned long long change_state;
+  char name[32];
+  int i, f, functions, pragmas, seed, changed, change;
+
+  if (argc < 2)
+    usage(argv[0]);
+
+  functions = atoi(argv[1]);
+  statements = 10;
+  comments = 20;
+  literals = 10;
+  pragmas = 10;
+  depth = 2;
+  width = 2;
+  seed = 1;
+  changed = 0;
+  for (i = 2; i < argc; i++)
+    {
+      if (strncmp(argv[i], "-statements=", 12) == 0)
+	sscanf(argv[i], "-statements=%i", &statements);
+      else if (strncmp(argv[i], "-comments=", 10) == 0)
+	sscanf(argv[i], "-comments=%i", &comments);
+      else if (strncmp(argv[i], "-literals=", 10) == 0)
+	sscanf(argv[i], "-literals=%i", &literals);
+      else if (strncmp(argv[i], "-pragmas=", 9) == 0)
+	sscanf(argv[i], "-pragmas=%i", &pragmas);
+      else if (strncmp(argv[i], "-depth=", 7) == 0)
+	sscanf(argv[i], "-depth=%i", &depth);
+      else if (strncmp(argv[i], "-width=", 7) == 0)
+	sscanf(argv[i], "-width=%i", &width);
+      else if (strncmp(argv[i], "-seed=", 6) == 0)
+	sscanf(argv[i], "-seed=%i", &seed);
+      else if (strncmp(argv[i], "-changed=", 9) == 0)
+	sscanf(argv[i], "-changed=%i", &changed);
+      else
+	{
+	  printf("Invalid argument %s\n", argv[i]);
+	  usage(argv[0]);
+	}
+    }
+  if ((functions < 0) || (statements < 1) || (width < 1))
+    usage(argv[0]);
+
+  /* the changes are drawn apart, so that they do not move the rest */
+  state = 88172645463325252ULL ^ (unsigned long long) seed * 2654435761ULL;
+  change_state = state ^ 0x9e3779b97f4a7c15ULL;
+
+  printf("/* generated by gen_bench_source */\n\n#include <stdio.h>\n\n");
+  printf("static int y = %i;\n\n", seed);
+  for (f = 0; f < functions; f++)
+    {
+      change = (next_random(&change_state, 100) < changed);
+
+      printf("int function_%i(int a, char * s)\n{\n  int x = a;\n\n", f);
+      for (i = 0; i < statements; i++)
+	{
+	  statement(f, i, change);
+	  if ((i == statements / 2) && (pragmas > 0) && (depth > 0)
+	      && (f % pragmas == 0))
+	    {
+	      sprintf(name, "%i", f);
+	      conditionals(f, depth, name);
+	    }
+	}
+      printf("  return x;\n}\n\n");
+    }
+
+  return 0;
+}
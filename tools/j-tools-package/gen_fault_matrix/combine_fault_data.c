@@ -5,76 +5,326 @@
 #include "defs.h"
 #include "file_utils.h"
 
-#define MAX(x, y) ((x) > (y) ? (x) : (y))
+/* one line of fault data; only the cells read are kept, so the
+   storage grows with the input rather than with versions * tests */
+typedef struct
+{
+  int version, testid, exposed, order;
+} cell;
 
-int main(int argc, char * * argv)
+static int compare_cells(const void * a, const void * b)
+{
+  const cell * x = (const cell *) a, * y = (const cell *) b;
+
+  if (x->version != y->version)
+    return (x->version < y->version) ? -1 : 1;
+  if (x->testid != y->testid)
+    return (x->testid < y->testid) ? -1 : 1;
+  return (x->order < y->order) ? -1 : (x->order > y->order);
+}
+
+/* the input is read in chunks of at least CHUNK bytes; a line that
+   does not fit in the buffer makes it grow */
+#define CHUNK (1 << 20)
+
+typedef struct
 {
-  static data[MAX_VERS][MAX_TESTS];
-  int testid, version, tests, versions, i, j, exposed, n;
   FILE * f;
-  char * input, * output, * universe;
-  static char buffer[MAX_READ_LINE + 1];
-  char * s = NULL;
+  char * buffer;
+  int size, start, end, eof;
+} reader;
 
-  if (argc != 4)
+/* returns the next line of 'r', without its newline and NUL
+   terminated in place, or NULL at the end of the input */
+static char * next_line(reader * r, size_t * length)
+{
+  char * line, * nl;
+
+  for (;;)
     {
-      printf("%s <input fault data> <universe file> <output fault matrix>\n", argv[0]);
-      exit(-1);
+      line = r->buffer + r->start;
+      nl = NULL;
+      if (r->start < r->end)
+	nl = memchr(line, '\n', r->end - r->start);
+      if ((nl != NULL) || (r->eof && (r->start < r->end)))
+	{
+	  if (nl == NULL)
+	    nl = r->buffer + r->end;
+	  *nl = 0;
+	  *length = nl - line;
+	  r->start = nl - r->buffer + 1;
+	  return line;
+	}
+      if (r->eof)
+	return NULL;
+
+      /* keep the partial line, and make room for one more chunk */
+      memmove(r->buffer, line, r->end - r->start);
+      r->end -= r->start;
+      r->start = 0;
+      if (r->size - r->end < CHUNK + 1)
+	{
+	  r->size = 2 * r->size + CHUNK + 1;
+	  r->buffer = (char *) realloc(r->buffer, r->size);
+	  if (r->buffer == NULL)
+	    {
+	      printf("Cannot allocate memory for the input buffer\n");
+	      exit(-1);
+	    }
+	}
+      r->end += fread(r->buffer + r->end, 1, r->size - r->end - 1, r->f);
+      if (feof(r->f) || ferror(r->f))
+	r->eof = 1;
     }
-  
-  input = argv[1];
-  universe = argv[2];
-  output = argv[3];
+}
 
-  n = getNumberLines(input);
+/* parses the next of the fields of 'line' separated by ':' and ' ',
+   which must be a decimal number */
+static int next_field(char * * line)
+{
+  char * s = *line;
+  int n, sign;
 
-  f = fopen(input, "r");
+  /* skip the field name, as in "Version:12" */
+  while ((*s == ':') || (*s == ' '))
+    s++;
+  assert(*s != 0);
+  while ((*s != 0) && (*s != ':') && (*s != ' '))
+    s++;
+  while ((*s == ':') || (*s == ' '))
+    s++;
+  assert(*s != 0);
+
+  sign = 1;
+  if (*s == '-')
+    {
+      sign = -1;
+      s++;
+    }
+  for (n = 0; (*s >= '0') && (*s <= '9'); s++)
+    n = 10 * n + (*s - '0');
+  while ((*s != 0) && (*s != ':') && (*s != ' '))
+    s++;
+
+  *line = s;
+  return sign * n;
+}
+
+/* reads the cells of 'input', "-" for the standard input, in order;
+   *versions and *tests get the largest version and test number + 1 */
+static cell * read_cells(char * input, int * num, int * versions, int * tests)
+{
+  cell * cells;
+  int testid, version, exposed, n, max_cells;
+  size_t length;
+  FILE * f;
+  char * s = NULL;
+  reader r;
+
+  /* "-" reads the fault data from the standard input, so that the
+     scripts can pipe it in */
+  if (strcmp(input, "-") == 0)
+    f = stdin;
+  else
+    f = fopen(input, "r");
   if (f == NULL)
     {
       printf("Cannot open file %s\n", input);
       exit(-1);
     }
 
-  versions = 0;
-  tests = 0;
-  for (i = 0; i < n; i++)
+  r.f = f;
+  r.size = 0;
+  r.buffer = NULL;
+  r.start = r.end = r.eof = 0;
+
+  max_cells = 1024;
+  cells = (cell *) malloc(max_cells * sizeof(cell));
+  if (cells == NULL)
     {
-      fgets(buffer, MAX_READ_LINE, f);
-      buffer[strlen(buffer) - 1] = 0;
-
-      s = strtok(buffer, ": ");
-      assert(s != NULL);
-      s = strtok(NULL, ": ");
-      assert(s != NULL);
-      sscanf(s, "%i", &version);
-
-      s = strtok(NULL, ": ");
-      assert(s != NULL);
-      s = strtok(NULL, ": ");
-      assert(s != NULL);
-      sscanf(s, "%i", &testid);
-
-      s = strtok(NULL, ": ");
-      assert(s != NULL);
-      s = strtok(NULL, ": ");
-      assert(s != NULL);
-      sscanf(s, "%i", &exposed);
+      printf("Cannot allocate memory for the lines of %s\n", input);
+      exit(-1);
+    }
 
-      /*      printf("version = %i, test = %i, exposed = %i\n", version, testid, exposed); */
+  /* each line is "Version:<v> Test:<t> Exposed:<e>" */
+  *versions = 0;
+  *tests = 0;
+  n = 0;
+  while ((s = next_line(&r, &length)) != NULL)
+    {
+      if (strspn(s, " \t\r") == length)
+	continue;
 
-      versions = MAX(versions, version);
-      tests = MAX(tests, testid + 1);
+      version = next_field(&s);
+      testid = next_field(&s);
+      exposed = next_field(&s);
+
+      /*      printf("version = %i, test = %i, exposed = %i\n", version, testid, exposed); */
 
-      assert(versions < MAX_VERS);
-      assert(tests < MAX_TESTS);
+      *versions = MAX(*versions, version);
+      *tests = MAX(*tests, testid + 1);
 
       assert(testid >= 0);
       assert(version > 0);
 
-      data[version][testid] = exposed;
+      if (n == max_cells)
+	{
+	  max_cells *= 2;
+	  cells = (cell *) realloc(cells, max_cells * sizeof(cell));
+	  if (cells == NULL)
+	    {
+	      printf("Cannot allocate memory for %i lines of %s\n", max_cells, input);
+	      exit(-1);
+	    }
+	}
+      cells[n].version = version;
+      cells[n].testid = testid;
+      cells[n].exposed = exposed;
+      cells[n].order = n;
+      n++;
     }
 
-  fclose(f);
+  if (f != stdin)
+    fclose(f);
+  free(r.buffer);
+
+  *num = n;
+  return cells;
+}
+
+/* merges the cells of 'input' into the existing 'matrix', which gets
+   the new tests and versions; the universe lines of the new tests are
+   the lines of 'universe' after those of the matrix, without the
+   CLASSPATH and setenv lines which read_matrix skips */
+static void update_matrix(char * input, char * matrix, char * universe)
+{
+  fault_matrix fm;
+  line_slab slab;
+  cell * cells;
+  char * * lines, * * test_lines;
+  int i, n, tests, versions, new_tests, num_lines, num_test_lines;
+
+  cells = read_cells(input, &n, &versions, &tests);
+
+  fm_init(&fm);
+  if (! fm_read_update(&fm, matrix))
+    exit(-1);
+
+  tests = MAX(tests, fm.numtests);
+  versions = MAX(versions, fm.numversions);
+  new_tests = tests - fm.numtests;
+  lines = NULL;
+  test_lines = NULL;
+  slab.data = NULL;
+  slab.lines = NULL;
+  if (new_tests > 0)
+    {
+      num_lines = (universe != NULL) ? (load_line_slab(universe, &slab)) : (-1);
+      test_lines = (char * *) malloc(((num_lines > 0) ? num_lines : 1) * sizeof(char *));
+      lines = (char * *) malloc(new_tests * sizeof(char *));
+      if ((test_lines == NULL) || (lines == NULL))
+	{
+	  printf("Cannot allocate memory for %i tests\n", new_tests);
+	  exit(-1);
+	}
+
+      /* the lines of the tests, numbered as read_matrix numbers them */
+      for (i = 0, num_test_lines = 0; i < num_lines; i++)
+	if (! skipped_universe_line(slab.lines[i]))
+	  test_lines[num_test_lines++] = slab.lines[i];
+      if (num_test_lines < tests)
+	{
+	  printf("The universe file must have the lines of the %i tests\n", tests);
+	  exit(-1);
+	}
+
+      for (i = 0; i < new_tests; i++)
+	{
+	  lines[i] = (char *) malloc(strlen(test_lines[fm.numtests + i]) + 2);
+	  if (lines[i] == NULL)
+	    {
+	      printf("Cannot allocate memory for %i tests\n", new_tests);
+	      exit(-1);
+	    }
+	  sprintf(lines[i], "%s\n", test_lines[fm.numtests + i]);
+	}
+    }
+
+  if (! fm_resize(&fm, tests, versions, lines))
+    exit(-1);
+
+  /* in the order read, the last line for a cell wins */
+  for (i = 0; i < n; i++)
+    if (! fm_set_exposed(&fm, cells[i].testid, cells[i].version, cells[i].exposed))
+      exit(-1);
+
+  if (! fm_save(&fm, matrix))
+    exit(-1);
+
+  for (i = 0; i < new_tests; i++)
+    free(lines[i]);
+  free(lines);
+  free(test_lines);
+  free_line_slab(&slab);
+  free(cells);
+  fm_free(&fm);
+}
+
+int main(int argc, char * * argv)
+{
+  cell * cells;
+  int * first, * next;
+  int tests, versions, i, j, k, exposed, n, num_cells;
+  FILE * f;
+  char * input, * output, * universe;
+
+  if ((argc >= 4) && (argc <= 5) && (strcmp(argv[1], "-update") == 0))
+    {
+      update_matrix(argv[2], argv[3], (argc == 5) ? (argv[4]) : (NULL));
+      return 0;
+    }
+
+  if (argc != 4)
+    {
+      printf("%s <input fault data|-> <universe file> <output fault matrix>\n", argv[0]);
+      printf("%s -update <input fault data|-> <fault matrix> [<universe file>]\n", argv[0]);
+      exit(-1);
+    }
+  
+  input = argv[1];
+  universe = argv[2];
+  output = argv[3];
+
+  cells = read_cells(input, &n, &versions, &tests);
+
+  /* sort by version and test; the last line read for a cell wins, and
+     the cells left at 0 are dropped, so each version keeps the sorted
+     list of the tests exposing it, from cells[first[v]] on */
+  qsort(cells, n, sizeof(cell), compare_cells);
+  num_cells = 0;
+  for (i = 0; i < n; i++)
+    {
+      if ((i + 1 < n) && (cells[i + 1].version == cells[i].version)
+	  && (cells[i + 1].testid == cells[i].testid))
+	continue;
+      if (cells[i].exposed != 0)
+	cells[num_cells++] = cells[i];
+    }
+
+  first = (int *) malloc((versions + 2) * sizeof(int));
+  next = (int *) malloc((versions + 2) * sizeof(int));
+  if ((first == NULL) || (next == NULL))
+    {
+      printf("Cannot allocate memory for %i versions\n", versions);
+      exit(-1);
+    }
+  for (j = 1, k = 0; j <= versions + 1; j++)
+    {
+      while ((k < num_cells) && (cells[k].version < j))
+	k++;
+      first[j] = k;
+      next[j] = k;
+    }
 
   f = fopen(output, "w");
   if (f == NULL)
@@ -92,10 +342,19 @@ int main(int argc, char * * argv)
     {
       fprintf(f, "unitest%i:\n", i);
       for (j = 1; j <= versions; j++)
-	fprintf(f, "v%i:\n\t%i\n", j, data[j][i]);
+	{
+	  exposed = 0;
+	  if ((next[j] < first[j + 1]) && (cells[next[j]].testid == i))
+	    exposed = cells[next[j]++].exposed;
+	  fprintf(f, "v%i:\n\t%i\n", j, exposed);
+	}
     }
 
   fclose(f);
 
+  free(cells);
+  free(first);
+  free(next);
+
   return 0;
 }
@@ -0,0 +1,272 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "defs.h"
+#include "file_utils.h"
+
+/* compares the outputs of a faulty version or mutant with the stored
+   outputs, the way the cmp -s loop of get_data_version_adj_mutation_junit.sh
+   does, and writes a Version/Test/Exposed record per test for
+   combine_fault_data.  The output of a test is t<line of the testId
+   file>.
+
+   Outputs of different sizes are never read.  Without a cache the files
+   are compared until their first difference; with -cache=<file> the
+   sizes and hashes of the stored outputs are kept in the file, computed
+   the first time for a version and whenever a stored output changes,
+   so that a stored output is read only when its hash is the one of the
+   new output, to confirm that they are equal.  With -hash_only equal
+   hashes are taken for equal outputs without reading the stored one:
+   two different outputs with the same 64-bit hash are then recorded as
+   not exposing the fault */
+
+typedef struct
+{
+  char * name;			/* t<id> */
+  long long size;
+  long long mtime;
+  unsigned long long hash;
+  int valid;			/* whether the stored output can be read */
+} stored_output;
+
+static stored_output * outputs;
+static int num_outputs;
+
+static void * allocate(int size)
+{
+  void * p;
+
+  p = malloc((size > 0) ? size : 1);
+  if (p == NULL)
+    {
+      printf("Cannot allocate memory for %i tests\n", num_outputs);
+      exit(-1);
+    }
+
+  return p;
+}
+
+static char * path(char * dir, char * name)
+{
+  char * s;
+
+  s = allocate(strlen(dir) + strlen(name) + 2);
+  sprintf(s, "%s/%s", dir, name);
+
+  return s;
+}
+
+static int compare_names(const void * a, const void * b)
+{
+  return strcmp(((const stored_output *) a)->name, ((const stored_output *) b)->name);
+}
+
+/* the entries of the cache, sorted by name, *n gets their number */
+static stored_output * read_cache(char * file, int * n)
+{
+  line_slab slab;
+  stored_output * cache;
+  char * name;
+  int i;
+
+  *n = 0;
+  if (load_line_slab(file, &slab) < 0)
+    return NULL;
+
+  cache = allocate(slab.numlines * sizeof(stored_output));
+  for (i = 0; i < slab.numlines; i++)
+    {
+      name = allocate(strlen(slab.lines[i]) + 1);
+      if (sscanf(slab.lines[i], "%s %lli %lli %llx", name, &cache[*n].size,
+		 &cache[*n].mtime, &cache[*n].hash) == 4)
+	{
+	  cache[*n].name = name;
+	  cache[*n].valid = 1;
+	  (*n)++;
+	}
+      else
+	free(name);
+    }
+  free_line_slab(&slab);
+  qsort(cache, *n, sizeof(stored_output), compare_names);
+
+  return cache;
+}
+
+static void write_cache(char * file)
+{
+  FILE * f;
+  int i;
+
+  f = fopen(file, "w");
+  if (f == NULL)
+    {
+      printf("Cannot open file %s for writing\n", file);
+      return;
+    }
+  for (i = 0; i < num_outputs; i++)
+    if (outputs[i].valid)
+      fprintf(f, "%s %lli %lli %llx\n", outputs[i].name, outputs[i].size,
+	      outputs[i].mtime, outputs[i].hash);
+  fclose(f);
+}
+
+/* the sizes, and with a cache the hashes, of the stored outputs;
+   returns whether the cache has to be written again */
+static int load_stored(char * stored_dir, char * cache_file)
+{
+  stored_output * cache, * entry, key;
+  struct stat st;
+  char * file;
+  int i, n, changed;
+
+  cache = NULL;
+  n = 0;
+  if (cache_file != NULL)
+    cache = read_cache(cache_file, &n);
+
+  changed = 0;
+  for (i = 0; i < num_outputs; i++)
+    {
+      file = path(stored_dir, outputs[i].name);
+      outputs[i].valid = (stat(file, &st) == 0);
+      if (outputs[i].valid)
+	{
+	  outputs[i].size = st.st_size;
+	  outputs[i].mtime = st.st_mtime;
+	}
+
+      if (outputs[i].valid && (cache_file != NULL))
+	{
+	  key.name = outputs[i].name;
+	  entry = bsearch(&key, cache, n, sizeof(stored_output), compare_names);
+	  if ((entry != NULL) && (entry->size == outputs[i].size)
+	      && (entry->mtime == outputs[i].mtime))
+	    outputs[i].hash = entry->hash;
+	  else
+	    {
+	      outputs[i].valid = (hash_file(file, &outputs[i].hash, &outputs[i].size) == 0);
+	      changed = 1;
+	    }
+	}
+      free(file);
+    }
+
+  for (i = 0; i < n; i++)
+    free(cache[i].name);
+  free(cache);
+
+  return changed;
+}
+
+/* whether the output of test i in 'dir' differs from the stored one */
+static int exposed(int i, char * dir, char * stored_dir, int hashed, int hash_only)
+{
+  struct stat st;
+  unsigned long long hash;
+  long long size;
+  char * file, * stored;
+  int differ;
+
+  if (! outputs[i].valid)
+    return 1;
+
+  file = path(dir, outputs[i].name);
+  if ((stat(file, &st) != 0) || (st.st_size != outputs[i].size))
+    differ = 1;
+  else if (hashed && ((hash_file(file, &hash, &size) != 0) || (size != outputs[i].size)
+			|| (hash != outputs[i].hash)))
+    differ = 1;
+  else if (hashed && hash_only)
+    differ = 0;
+  else
+    {
+      /* equal hashes, or no hashes: the files are compared */
+      stored = path(stored_dir, outputs[i].name);
+      differ = files_differ(file, stored);
+      free(stored);
+    }
+  free(file);
+
+  return differ;
+}
+
+static void usage(char * name)
+{
+  printf("%s <stored outputs dir> <outputs dir> <testId file> <fault number> [-cache=<file> [-hash_only]] [-records=<file>]\n", name);
+  exit(-1);
+}
+
+int main(int argc, char * * argv)
+{
+  line_slab testids;
+  char * stored_dir, * dir, * cache_file, * records_file;
+  int i, fault, flag_hash_only;
+  FILE * records;
+
+  if (argc < 5)
+    usage(argv[0]);
+
+  stored_dir = argv[1];
+  dir = argv[2];
+  fault = atoi(argv[4]);
+  cache_file = NULL;
+  records_file = NULL;
+  flag_hash_only = 0;
+  for (i = 5; i < argc; i++)
+    {
+      if (strncmp(argv[i], "-cache=", 7) == 0)
+	cache_file = argv[i] + 7;
+      else if (strncmp(argv[i], "-records=", 9) == 0)
+	records_file = argv[i] + 9;
+      else if (strcmp(argv[i], "-hash_only") == 0)
+	flag_hash_only = 1;
+      else
+	{
+	  printf("Invalid argument %s\n", argv[i]);
+	  usage(argv[0]);
+	}
+    }
+
+  if (load_line_slab(argv[3], &testids) < 0)
+    {
+      printf("Cannot open file %s for reading\n", argv[3]);
+      exit(-1);
+    }
+  num_outputs = testids.numlines;
+  outputs = allocate(num_outputs * sizeof(stored_output));
+  for (i = 0; i < num_outputs; i++)
+    {
+      outputs[i].name = allocate(strlen(testids.lines[i]) + 2);
+      sprintf(outputs[i].name, "t%s", testids.lines[i]);
+    }
+  free_line_slab(&testids);
+
+  if (load_stored(stored_dir, cache_file))
+    write_cache(cache_file);
+
+  records = stdout;
+  if (records_file != NULL)
+    {
+      records = fopen(records_file, "a");
+      if (records == NULL)
+	{
+	  printf("Cannot open file %s for writing\n", records_file);
+	  exit(-1);
+	}
+    }
+
+  for (i = 0; i < num_outputs; i++)
+    fprintf(records, "Version:%i Test:%i Exposed:%i\n", fault, i,
+	    exposed(i, dir, stored_dir, cache_file != NULL, flag_hash_only));
+
+  if (records != stdout)
+    fclose(records);
+  for (i = 0; i < num_outputs; i++)
+    free(outputs[i].name);
+  free(outputs);
+
+  return 0;
+}
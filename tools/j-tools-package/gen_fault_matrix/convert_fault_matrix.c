@@ -0,0 +1,44 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "defs.h"
+
+/* converts a fault matrix between the text and the binary format,
+   by default into the format the input is not in */
+
+int main(int argc, char * * argv)
+{
+  char * input, * output;
+  int binary;
+
+  if ((argc < 3) || (argc > 4))
+    {
+      printf("%s <input fault matrix> <output fault matrix> [-binary|-text]\n", argv[0]);
+      exit(-1);
+    }
+
+  input = argv[1];
+  output = argv[2];
+
+  binary = ! is_binary_matrix(input);
+  if (argc == 4)
+    {
+      if (strcmp(argv[3], "-binary") == 0)
+	binary = 1;
+      else if (strcmp(argv[3], "-text") == 0)
+	binary = 0;
+      else
+	{
+	  printf("Unknown option %s\n", argv[3]);
+	  exit(-1);
+	}
+    }
+
+  if (! read_matrix(input))
+    exit(-1);
+
+  if (! ((binary) ? (write_matrix_binary(output)) : (write_matrix_text(output))))
+    exit(-1);
+
+  return 0;
+}
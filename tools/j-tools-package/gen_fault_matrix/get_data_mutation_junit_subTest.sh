@@ -92,6 +92,10 @@ do
 
 	f=${fault_start}
 	bound_mutants=`expr ${fault_start} + ${mutants}`
+        # the classes are hard linked to source_org once per version,
+        # only the class of each mutant is swapped in and back
+        rm -rf ${subject_dir}/source/ant/build/classes/org
+        cp -rl ${subject_dir}/source_org/org ${subject_dir}/source/ant/build/classes/.
         cd ${subject_dir}/mutants
         while read LINE
         do
@@ -100,8 +104,6 @@ do
                 # change file.M* to file.class
                 className=`echo $LINE | sed "s/\.M[0-9]*/\.class/"`
                 echo $className
-                rm -rf ${subject_dir}/source/ant/build/classes/org
-                cp -r ${subject_dir}/source_org/org ${subject_dir}/source/ant/build/classes/.
                 echo copy mutant $LINE
                 rm -f ${subject_dir}/source/ant/build/classes/$className
                 cp $LINE  ${subject_dir}/source/ant/build/classes/$className
@@ -116,11 +118,18 @@ do
                     rm -rf ${subject_dir}/outputs.alt/v${v}/M${f}/*
                 fi
                 mv ${subject_dir}/outputs/* ${subject_dir}/outputs.alt/v${v}/M${f}/.
+                rm -f ${subject_dir}/source/ant/build/classes/$className
+                if [ -r ${subject_dir}/source_org/$className ]
+                then
+                    ln ${subject_dir}/source_org/$className ${subject_dir}/source/ant/build/classes/$className
+                fi
 	    fi
 	    cd ${subject_dir}/mutants
 	    f=`expr $f + 1`
 
 	done < ${mutants_file_name}
+        rm -rf ${subject_dir}/source/ant/build/classes/org
+        cp -r ${subject_dir}/source_org/org ${subject_dir}/source/ant/build/classes/.
 
 	cd ${current_dir}
 	fault_matrix_dir=${fault_matrix_prefix}/v${v}
@@ -27,25 +27,9 @@ t_num=`cat ${testId} | wc -l`
 cat ${testId} | sh runTests.sh junit.textui.SelectiveTestRunner -o ${subject_dir}/outputs
 cd ${current_dir}
 
-n=0
-while read LINE
-    do
-#	echo Doing for test ${n}
-	exp=0
-	nplus=$LINE
-	echo testTD $nplus
-	current_dir=`pwd`
-	cd ${subject_dir}/scripts
-	cd ${current_dir}
-        if (cmp -s ${subject_dir}/outputs/t${nplus} ${subject_dir}/outputs.alt/v${version}/orig/t${nplus}) then
-               	exp=0
-	   else
-		exp=1
-        fi
-	echo testNumber $n
-        echo "Version:${fault_number} Test:${n} Exposed:${exp}" >> ${all_diffs}
-	n=`expr $n + 1`
-    done < ${testId}
+# the stored outputs are hashed once per version, in ${subject_dir}/outputs.alt/v${version}/orig.hashes
+./compare_outputs ${subject_dir}/outputs.alt/v${version}/orig ${subject_dir}/outputs ${testId} ${fault_number} \
+	-cache=${subject_dir}/outputs.alt/v${version}/orig.hashes -records=${all_diffs}
 
 rm -f ${script} ${diffs} ${ascript}
 
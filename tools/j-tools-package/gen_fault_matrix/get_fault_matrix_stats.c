@@ -1,48 +1,553 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
 #include "defs.h"
 
-#define MAX(x, y) ((x) > (y) ? (x) : (y))
 
-int main(int argc, char * * argv)
+/* the faults (tests) a worker takes from the pool at a time */
+#define JOB_CHUNK 64
+
+int number_of_threads = 1;
+
+static int tests, faults;
+static int * counts;		/* exposing tests of each fault */
+static unsigned long long * hashes;	/* of the set of each fault */
+static int * order;		/* faults sorted by their sets */
+static int * subsumer;		/* fault subsuming each fault, 0 if none */
+static int * representatives;	/* detected faults, one per set */
+static int num_representatives;
+static int * kills;		/* faults exposed by each test */
+
+/*----------------------------------------------------------------*/
+/* a pool of threads running work(i) for i in [0, n)              */
+
+typedef struct
 {
-  int i, j, tests, faults, exposed, counter;
-  char * input;
+  pthread_mutex_t lock;
+  int next, n;
+  void (* work)(int);
+} job_pool;
+
+static void * job_worker(void * arg)
+{
+  job_pool * pool = arg;
+  int i, start;
+
+  while (1)
+    {
+      pthread_mutex_lock(&pool->lock);
+      start = pool->next;
+      pool->next += JOB_CHUNK;
+      pthread_mutex_unlock(&pool->lock);
+
+      if (start >= pool->n)
+	break;
 
-  if (argc != 2)
+      for (i = start; i < MIN(start + JOB_CHUNK, pool->n); i++)
+	pool->work(i);
+    }
+
+  return NULL;
+}
+
+static void run_jobs(int n, void (* work)(int))
+{
+  job_pool pool;
+  pthread_t * workers;
+  int i, threads;
+
+  threads = MAX(MIN(number_of_threads, (n + JOB_CHUNK - 1) / JOB_CHUNK), 1);
+  if (threads == 1)
     {
-      printf("%s <fault matrix>\n", argv[0]);
+      for (i = 0; i < n; i++)
+	work(i);
+      return;
+    }
+
+  pool.next = 0;
+  pool.n = n;
+  pool.work = work;
+  pthread_mutex_init(&pool.lock, NULL);
+
+  workers = malloc(threads * sizeof(pthread_t));
+  if (workers == NULL)
+    {
+      printf("Cannot allocate memory for %i threads\n", threads);
       exit(-1);
     }
+  for (i = 0; i < threads; i++)
+    if (pthread_create(&workers[i], NULL, job_worker, &pool) != 0)
+      {
+	printf("Cannot create thread\n");
+	exit(-1);
+      }
+  for (i = 0; i < threads; i++)
+    pthread_join(workers[i], NULL);
 
-  input = argv[1];
+  pthread_mutex_destroy(&pool.lock);
+  free(workers);
+}
 
-  read_matrix(input);
+static void * allocate(int n, int size)
+{
+  void * p;
 
-  faults = number_of_versions();
-  tests = number_of_tests();
+  p = calloc(MAX(n, 1), size);
+  if (p == NULL)
+    {
+      printf("Cannot allocate memory for the statistics\n");
+      exit(-1);
+    }
+
+  return p;
+}
+
+/*----------------------------------------------------------------*/
+/* per fault work, faults are numbered from 1                      */
+
+static void count_fault(int i)
+{
+  const bitword * set;
+  unsigned long long h;
+  int w;
+
+  set = exposing_tests(i + 1);
+  counts[i] = bitset_count(set, test_set_words());
+
+  /* FNV-1a over the words of the set */
+  h = 14695981039346656037ULL;
+  for (w = 0; w < test_set_words(); w++)
+    {
+      h ^= set[w];
+      h *= 1099511628211ULL;
+    }
+  hashes[i] = h;
+}
+
+static int compare_sets(const void * a, const void * b)
+{
+  int x = *(const int *) a, y = *(const int *) b;
+  int c;
+
+  if (hashes[x] != hashes[y])
+    return (hashes[x] < hashes[y]) ? -1 : 1;
+  c = memcmp(exposing_tests(x + 1), exposing_tests(y + 1),
+	     test_set_words() * sizeof(bitword));
+  if (c != 0)
+    return c;
+  return x - y;
+}
+
+static int same_set(int x, int y)
+{
+  return (hashes[x] == hashes[y])
+    && (memcmp(exposing_tests(x + 1), exposing_tests(y + 1),
+	       test_set_words() * sizeof(bitword)) == 0);
+}
+
+static int compare_by_count(const void * a, const void * b)
+{
+  int x = *(const int *) a, y = *(const int *) b;
+
+  if (counts[x] != counts[y])
+    return counts[x] - counts[y];
+  return x - y;
+}
+
+/* a fault is subsumed by a detected fault whose exposing tests are a
+   proper subset of its own: every test exposing that one exposes it.
+   Only the representatives of the sets are compared, by count */
+static void find_subsumer(int k)
+{
+  const bitword * set;
+  int i, a, b;
+
+  b = representatives[k];
+  set = exposing_tests(b + 1);
+  for (i = 0; i < k; i++)
+    {
+      a = representatives[i];
+      if (counts[a] == counts[b])
+	break;
+      if (bitset_andnot_count(exposing_tests(a + 1), set, test_set_words()) == 0)
+	{
+	  subsumer[b] = a + 1;
+	  return;
+	}
+    }
+}
+
+static void count_kills(int t)
+{
+  kills[t] = number_of_exposed_faults(t);
+}
+
+/* sorts the faults by their sets, so that duplicates are adjacent,
+   and keeps the first detected fault of each set */
+static void group_faults()
+{
+  int i;
+
+  if (order != NULL)
+    return;
+
+  order = allocate(faults, sizeof(int));
+  representatives = allocate(faults, sizeof(int));
+  for (i = 0; i < faults; i++)
+    order[i] = i;
+  qsort(order, faults, sizeof(int), compare_sets);
+
+  num_representatives = 0;
+  for (i = 0; i < faults; i++)
+    if ((counts[order[i]] > 0)
+	&& ((i == 0) || ! same_set(order[i - 1], order[i])))
+      representatives[num_representatives++] = order[i];
+}
+
+/*----------------------------------------------------------------*/
+/* the statistics                                                  */
+
+static void print_list_item(int * counter, int item)
+{
+  if (((*counter) % 10) == 0)
+    printf("\n\t");
+  (*counter)++;
+  printf("%i ", item);
+}
+
+static void print_exposing()
+{
+  int i, j, exposed, counter;
+  const bitword * set;
 
   for (j = 1; j <= faults; j++)
     {
       printf("--------------------------------\n");
       printf("Statistics for fault %i:\n", j);
       printf("Tests which expose this fault: ");
-      exposed = 0;
+      exposed = counts[j - 1];
       counter = 0;
-      for (i = 0; i < tests; i++)
+      set = exposing_tests(j);
+      for (i = bitset_next(set, tests, 0); i >= 0; i = bitset_next(set, tests, i + 1))
 	{
-	  if (fault_exposed(i, j))
-	    {
-	      exposed++;
-	      if ((counter % 10) == 0)
-		printf("\n\t");
-	      counter++;
-	      printf("%i ", i);
-	    }
+	  if ((counter % 10) == 0)
+	    printf("\n\t");
+	  counter++;
+	  printf("%i ", i);
 	}
-      printf("\nPercentage of tests which expose this fault is %.5lf %c\n", 
+      printf("\nPercentage of tests which expose this fault is %.5lf %c\n",
 	     100.0 * ((double) exposed) / tests, '%');
     }
+}
+
+static int compare_ints(const void * a, const void * b)
+{
+  return *(const int *) a - *(const int *) b;
+}
+
+/* the number of faults exposed by a percentage of the tests in each
+   tenth of (0, 100], and the spread of the rates of detected faults */
+static void print_rates()
+{
+  int buckets[11];
+  int * detected;
+  int i, b, n, counter;
+  double rate, sum;
+
+  memset(buckets, 0, sizeof(buckets));
+  detected = allocate(faults, sizeof(int));
+  n = 0;
+  sum = 0;
+  for (i = 0; i < faults; i++)
+    {
+      if (counts[i] == 0)
+	{
+	  buckets[0]++;
+	  continue;
+	}
+      rate = 100.0 * counts[i] / tests;
+      b = (int) ((rate - 1e-9) / 10) + 1;
+      buckets[MIN(b, 10)]++;
+      detected[n++] = counts[i];
+      sum += rate;
+    }
+
+  printf("--------------------------------\n");
+  printf("Detection rates of %i faults by %i tests:\n", faults, tests);
+  printf("\t0%c: %i\n", '%', buckets[0]);
+  for (b = 1; b <= 10; b++)
+    printf("\t%i-%i%c: %i\n", (b - 1) * 10, b * 10, '%', buckets[b]);
+
+  if (n > 0)
+    {
+      qsort(detected, n, sizeof(int), compare_ints);
+      printf("Detected faults: %i, rates min %.5lf max %.5lf mean %.5lf median %.5lf %c\n",
+	     n, 100.0 * detected[0] / tests, 100.0 * detected[n - 1] / tests,
+	     sum / n, 100.0 * detected[n / 2] / tests, '%');
+    }
+  else
+    printf("Detected faults: 0\n");
+
+  printf("Undetected faults: ");
+  counter = 0;
+  for (i = 0; i < faults; i++)
+    if (counts[i] == 0)
+      print_list_item(&counter, i + 1);
+  printf("\n");
+
+  free(detected);
+}
+
+/* detected faults exposed by exactly the same tests */
+static void print_duplicates()
+{
+  int i, j, groups, counter;
+
+  group_faults();
+
+  printf("--------------------------------\n");
+  printf("Duplicate faults (exposed by the same tests):\n");
+  groups = 0;
+  for (i = 0; i < faults; i = j)
+    {
+      for (j = i + 1; (j < faults) && same_set(order[i], order[j]); j++);
+      if ((j - i < 2) || (counts[order[i]] == 0))
+	continue;
+      groups++;
+      printf("Faults exposed by the same %i tests: ", counts[order[i]]);
+      counter = 0;
+      for (; i < j; i++)
+	print_list_item(&counter, order[i] + 1);
+      printf("\n");
+    }
+  printf("Groups of duplicate faults: %i\n", groups);
+}
+
+static void print_subsumed()
+{
+  int i, j, n, minimal;
+
+  group_faults();
+
+  subsumer = allocate(faults, sizeof(int));
+  qsort(representatives, num_representatives, sizeof(int), compare_by_count);
+  run_jobs(num_representatives, find_subsumer);
+
+  /* the duplicates of a subsumed fault are subsumed by the same fault */
+  for (i = 0; i < faults; i = j)
+    for (j = i + 1; (j < faults) && same_set(order[i], order[j]); j++)
+      subsumer[order[j]] = subsumer[order[i]];
+
+  printf("--------------------------------\n");
+  printf("Subsumed faults (every test exposing the subsuming fault exposes them):\n");
+  n = 0;
+  for (i = 0; i < faults; i++)
+    if (subsumer[i] != 0)
+      {
+	printf("\tfault %i is subsumed by fault %i\n", i + 1, subsumer[i]);
+	n++;
+      }
+  minimal = 0;
+  for (i = 0; i < num_representatives; i++)
+    if (subsumer[representatives[i]] == 0)
+      minimal++;
+  printf("Subsumed faults: %i, minimal faults: %i\n", n, minimal);
+
+  free(subsumer);
+  subsumer = NULL;
+}
+
+/* greedy set cover: the test exposing the most faults not exposed yet
+   is taken until every detected fault is exposed.  The gains only
+   decrease, so a test is re-evaluated only when it reaches the top
+   of the heap */
+typedef struct
+{
+  int gain, test;
+} heap_entry;
+
+static int heap_before(heap_entry * x, heap_entry * y)
+{
+  return (x->gain > y->gain) || ((x->gain == y->gain) && (x->test < y->test));
+}
+
+static void heap_down(heap_entry * heap, int n, int i)
+{
+  heap_entry tmp;
+  int c;
+
+  while ((c = 2 * i + 1) < n)
+    {
+      if ((c + 1 < n) && heap_before(&heap[c + 1], &heap[c]))
+	c++;
+      if (! heap_before(&heap[c], &heap[i]))
+	break;
+      tmp = heap[i];
+      heap[i] = heap[c];
+      heap[c] = tmp;
+      i = c;
+    }
+}
+
+static void print_minimal()
+{
+  heap_entry * heap;
+  bitword * uncovered;
+  int i, n, gain, covered, selected, counter;
+  int * chosen;
+
+  if (kills == NULL)
+    {
+      kills = allocate(tests, sizeof(int));
+      run_jobs(tests, count_kills);
+    }
+
+  uncovered = bitset_alloc(faults);
+  for (i = 0; i < faults; i++)
+    if (counts[i] > 0)
+      BITSET_SET(uncovered, i);
+
+  heap = allocate(tests, sizeof(heap_entry));
+  chosen = allocate(tests, sizeof(int));
+  n = 0;
+  for (i = 0; i < tests; i++)
+    if (kills[i] > 0)
+      {
+	heap[n].gain = kills[i];
+	heap[n].test = i;
+	n++;
+      }
+  for (i = n / 2 - 1; i >= 0; i--)
+    heap_down(heap, n, i);
+
+  covered = 0;
+  selected = 0;
+  while (n > 0)
+    {
+      gain = bitset_and_count(exposed_faults(heap[0].test), uncovered,
+			      version_set_words());
+      if (gain == 0)
+	{
+	  heap[0] = heap[--n];
+	  heap_down(heap, n, 0);
+	  continue;
+	}
+      if (gain < heap[0].gain)
+	{
+	  heap[0].gain = gain;
+	  heap_down(heap, n, 0);
+	  continue;
+	}
+
+      chosen[selected++] = heap[0].test;
+      covered += gain;
+      bitset_andnot(uncovered, exposed_faults(heap[0].test), version_set_words());
+      heap[0] = heap[--n];
+      heap_down(heap, n, 0);
+    }
+
+  qsort(chosen, selected, sizeof(int), compare_ints);
+
+  printf("--------------------------------\n");
+  printf("Adequate test subset (greedy) of %i tests exposing %i faults: ",
+	 selected, covered);
+  counter = 0;
+  for (i = 0; i < selected; i++)
+    print_list_item(&counter, chosen[i]);
+  printf("\n");
+
+  free(heap);
+  free(chosen);
+  bitset_free(uncovered);
+}
+
+static void print_kills()
+{
+  int i;
+
+  if (kills == NULL)
+    {
+      kills = allocate(tests, sizeof(int));
+      run_jobs(tests, count_kills);
+    }
+
+  printf("--------------------------------\n");
+  printf("Faults exposed by each test:\n");
+  for (i = 0; i < tests; i++)
+    printf("\ttest %i: %i\n", i, kills[i]);
+}
+
+static void usage(char * name)
+{
+  printf("%s <fault matrix> [-exposing] [-rates] [-duplicates] [-subsumed] [-minimal] [-kills] [-threads=<n>]\n", name);
+  exit(-1);
+}
+
+int main(int argc, char * * argv)
+{
+  int i, flag_exposing, flag_rates, flag_duplicates, flag_subsumed,
+    flag_minimal, flag_kills;
+  char * input;
+
+  if (argc < 2)
+    usage(argv[0]);
+
+  input = argv[1];
+
+  flag_exposing = flag_rates = flag_duplicates = flag_subsumed = 0;
+  flag_minimal = flag_kills = 0;
+  number_of_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  for (i = 2; i < argc; i++)
+    {
+      if (strcmp(argv[i], "-exposing") == 0)
+	flag_exposing = 1;
+      else if (strcmp(argv[i], "-rates") == 0)
+	flag_rates = 1;
+      else if (strcmp(argv[i], "-duplicates") == 0)
+	flag_duplicates = 1;
+      else if (strcmp(argv[i], "-subsumed") == 0)
+	flag_subsumed = 1;
+      else if (strcmp(argv[i], "-minimal") == 0)
+	flag_minimal = 1;
+      else if (strcmp(argv[i], "-kills") == 0)
+	flag_kills = 1;
+      else if (strncmp(argv[i], "-threads=", 9) == 0)
+	sscanf(argv[i], "-threads=%i", &number_of_threads);
+      else
+	{
+	  printf("Invalid argument %s\n", argv[i]);
+	  usage(argv[0]);
+	}
+    }
+
+  /* without a mode the exposing tests of every fault are listed */
+  if (! (flag_rates || flag_duplicates || flag_subsumed || flag_minimal || flag_kills))
+    flag_exposing = 1;
+
+  if (! read_matrix(input))
+    exit(-1);
+
+  faults = number_of_versions();
+  tests = number_of_tests();
+
+  counts = allocate(faults, sizeof(int));
+  hashes = allocate(faults, sizeof(unsigned long long));
+  run_jobs(faults, count_fault);
+
+  if (flag_exposing)
+    print_exposing();
+  if (flag_rates)
+    print_rates();
+  if (flag_duplicates)
+    print_duplicates();
+  if (flag_subsumed)
+    print_subsumed();
+  if (flag_minimal)
+    print_minimal();
+  if (flag_kills)
+    print_kills();
 
   printf("--------------------------------\n");
 
@@ -0,0 +1,348 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "defs.h"
+#include "vers.h"
+
+/* orders the tests of a fault matrix by total or additional fault
+   coverage, or randomly, and computes the APFD of the order:
+
+     APFD = 1 - (TF1 + ... + TFm) / (n * m) + 1 / (2 * n)
+
+   where n is the number of tests, m the number of faults exposed by
+   some test and TFi the position of the first test exposing fault i */
+
+static int tests, faults;
+static bitword * active;	/* the faults taken into account */
+static int * coverage;		/* active faults exposed by each test */
+
+typedef struct
+{
+  int gain, test;
+} heap_entry;
+
+static int heap_before(heap_entry * x, heap_entry * y)
+{
+  return (x->gain > y->gain) || ((x->gain == y->gain) && (x->test < y->test));
+}
+
+static void heap_down(heap_entry * heap, int n, int i)
+{
+  heap_entry tmp;
+  int c;
+
+  while ((c = 2 * i + 1) < n)
+    {
+      if ((c + 1 < n) && heap_before(&heap[c + 1], &heap[c]))
+	c++;
+      if (! heap_before(&heap[c], &heap[i]))
+	break;
+      tmp = heap[i];
+      heap[i] = heap[c];
+      heap[c] = tmp;
+      i = c;
+    }
+}
+
+static void heap_build(heap_entry * heap, int n)
+{
+  int i;
+
+  for (i = n / 2 - 1; i >= 0; i--)
+    heap_down(heap, n, i);
+}
+
+static void * allocate(int n, int size)
+{
+  void * p;
+
+  p = calloc((n > 0) ? n : 1, size);
+  if (p == NULL)
+    {
+      printf("Cannot allocate memory for %i tests\n", tests);
+      exit(-1);
+    }
+
+  return p;
+}
+
+static int compare_coverage(const void * a, const void * b)
+{
+  int x = *(const int *) a, y = *(const int *) b;
+
+  if (coverage[x] != coverage[y])
+    return coverage[y] - coverage[x];
+  return x - y;
+}
+
+/* tests by the number of faults they expose */
+static void order_total(int * order)
+{
+  int i;
+
+  for (i = 0; i < tests; i++)
+    order[i] = i;
+  qsort(order, tests, sizeof(int), compare_coverage);
+}
+
+/* the test exposing the most faults not exposed by the tests before
+   it comes next; once every fault is exposed the faults are reset
+   for the remaining tests.  The gains only decrease until a reset,
+   so a test is re-evaluated only when it reaches the top of the heap */
+static void order_additional(int * order)
+{
+  heap_entry * heap;
+  bitword * uncovered;
+  int i, n, gain, placed, exposing;
+
+  heap = allocate(tests, sizeof(heap_entry));
+  uncovered = bitset_alloc(faults);
+
+  placed = 0;
+  while (placed < tests)
+    {
+      /* a round: the faults still exposed by the remaining tests */
+      bitset_zero(uncovered, version_set_words());
+      n = 0;
+      for (i = 0; i < tests; i++)
+	if (coverage[i] >= 0)
+	  {
+	    heap[n].gain = coverage[i];
+	    heap[n].test = i;
+	    n++;
+	    bitset_or(uncovered, exposed_faults(i), version_set_words());
+	  }
+      bitset_and(uncovered, active, version_set_words());
+      heap_build(heap, n);
+
+      exposing = 0;
+      while ((n > 0) && (heap[0].gain > 0))
+	{
+	  gain = bitset_and_count(exposed_faults(heap[0].test), uncovered,
+				  version_set_words());
+	  if (gain < heap[0].gain)
+	    {
+	      heap[0].gain = gain;
+	      heap_down(heap, n, 0);
+	      continue;
+	    }
+
+	  order[placed++] = heap[0].test;
+	  coverage[heap[0].test] = -1;
+	  bitset_andnot(uncovered, exposed_faults(heap[0].test), version_set_words());
+	  exposing++;
+	  heap[0] = heap[--n];
+	  heap_down(heap, n, 0);
+	}
+
+      /* the tests exposing no fault at all follow by their numbers */
+      if (exposing == 0)
+	{
+	  for (i = 0; i < tests; i++)
+	    if (coverage[i] >= 0)
+	      order[placed++] = i;
+	}
+    }
+
+  free(heap);
+  bitset_free(uncovered);
+}
+
+static void order_random(int * order, int seed)
+{
+  int i, j, t;
+
+  srand(seed);
+  for (i = 0; i < tests; i++)
+    order[i] = i;
+  for (i = tests - 1; i > 0; i--)
+    {
+      j = rand() % (i + 1);
+      t = order[i];
+      order[i] = order[j];
+      order[j] = t;
+    }
+}
+
+/* the order of the universe lines in 'file', which are looked up in
+   the matrix; lines not in the universe or repeated are skipped */
+static int order_given(int * order, char * file)
+{
+  int * ids;
+  int i, n, placed;
+  char * seen;
+
+  n = testids_for_universe_file(file, &ids);
+  if (n < 0)
+    exit(-1);
+
+  seen = allocate(tests, sizeof(char));
+  placed = 0;
+  for (i = 0; i < n; i++)
+    if ((ids[i] >= 0) && ! seen[ids[i]])
+      {
+	seen[ids[i]] = 1;
+	order[placed++] = ids[i];
+      }
+  if (placed < n)
+    printf("Warning: %i lines of %s are not tests of the universe\n", n - placed, file);
+
+  free(ids);
+  free(seen);
+
+  return placed;
+}
+
+static double apfd(int * order, int n, int * detected)
+{
+  bitword * uncovered;
+  double sum;
+  int i, newly;
+
+  uncovered = bitset_alloc(faults);
+  bitset_copy(uncovered, active, version_set_words());
+
+  sum = 0;
+  *detected = 0;
+  for (i = 0; i < n; i++)
+    {
+      newly = bitset_and_count(exposed_faults(order[i]), uncovered, version_set_words());
+      if (newly == 0)
+	continue;
+      sum += (double) newly * (i + 1);
+      *detected += newly;
+      bitset_andnot(uncovered, exposed_faults(order[i]), version_set_words());
+    }
+
+  bitset_free(uncovered);
+
+  if ((*detected == 0) || (n == 0))
+    return 0;
+
+  return 1.0 - sum / ((double) n * (*detected)) + 1.0 / (2.0 * n);
+}
+
+static void usage(char * name)
+{
+  printf("%s <fault matrix> <total|additional|random|given> [-seed=<n>] [-order=<universe lines file>] [-newVer=<file> -version=<n>] [-output=<file>] [-lines]\n", name);
+  exit(-1);
+}
+
+int main(int argc, char * * argv)
+{
+  int i, n, f, seed, version, detected, flag_lines;
+  char * input, * technique, * newver_file, * given_file, * output_file;
+  char * line;
+  int * order;
+  FILE * out;
+  double value;
+
+  if (argc < 3)
+    usage(argv[0]);
+
+  input = argv[1];
+  technique = argv[2];
+  seed = 0;
+  version = 0;
+  flag_lines = 0;
+  newver_file = NULL;
+  given_file = NULL;
+  output_file = NULL;
+  for (i = 3; i < argc; i++)
+    {
+      if (strncmp(argv[i], "-seed=", 6) == 0)
+	sscanf(argv[i], "-seed=%i", &seed);
+      else if (strncmp(argv[i], "-version=", 9) == 0)
+	sscanf(argv[i], "-version=%i", &version);
+      else if (strncmp(argv[i], "-newVer=", 8) == 0)
+	newver_file = argv[i] + 8;
+      else if (strncmp(argv[i], "-order=", 7) == 0)
+	given_file = argv[i] + 7;
+      else if (strncmp(argv[i], "-output=", 8) == 0)
+	output_file = argv[i] + 8;
+      else if (strcmp(argv[i], "-lines") == 0)
+	flag_lines = 1;
+      else
+	{
+	  printf("Invalid argument %s\n", argv[i]);
+	  usage(argv[0]);
+	}
+    }
+
+  if (((newver_file == NULL) != (version == 0))
+      || ((strcmp(technique, "given") == 0) != (given_file != NULL)))
+    usage(argv[0]);
+
+  if (! read_matrix(input))
+    exit(-1);
+
+  tests = number_of_tests();
+  faults = number_of_versions();
+
+  /* with a newVer file only the faults seeded in the version count */
+  active = bitset_alloc(faults);
+  if (newver_file != NULL)
+    {
+      if (get_line_size_v(newver_file) - 2 < faults)
+	{
+	  printf("newVer file %s has fewer faults than the %i of %s\n",
+		 newver_file, faults, input);
+	  exit(-1);
+	}
+      load_faults(newver_file);
+    }
+  for (f = 1; f <= faults; f++)
+    if ((newver_file == NULL) || version_has_fault(version, f))
+      BITSET_SET(active, f - 1);
+
+  coverage = allocate(tests, sizeof(int));
+  for (i = 0; i < tests; i++)
+    coverage[i] = bitset_and_count(exposed_faults(i), active, version_set_words());
+
+  order = allocate(tests, sizeof(int));
+  n = tests;
+  if (strcmp(technique, "total") == 0)
+    order_total(order);
+  else if (strcmp(technique, "additional") == 0)
+    order_additional(order);
+  else if (strcmp(technique, "random") == 0)
+    order_random(order, seed);
+  else if (strcmp(technique, "given") == 0)
+    n = order_given(order, given_file);
+  else
+    usage(argv[0]);
+
+  if (output_file != NULL)
+    {
+      out = fopen(output_file, "w");
+      if (out == NULL)
+	{
+	  printf("Cannot open file %s for writing\n", output_file);
+	  exit(-1);
+	}
+
+      line = allocate(INPUTMAX, sizeof(char));
+      for (i = 0; i < n; i++)
+	{
+	  if (flag_lines)
+	    {
+	      fault_matrix_copy_universe_line(order[i], line);
+	      fprintf(out, "%s\n", line);
+	    }
+	  else
+	    fprintf(out, "%i\n", order[i]);
+	}
+      free(line);
+      fclose(out);
+    }
+
+  value = apfd(order, n, &detected);
+  printf("APFD of the %s order of %i tests on %i faults is %.5lf\n",
+	 technique, n, detected, value);
+
+  free(order);
+  free(coverage);
+  bitset_free(active);
+
+  return 0;
+}
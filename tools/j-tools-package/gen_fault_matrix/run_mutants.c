@@ -0,0 +1,561 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "defs.h"
+#include "file_utils.h"
+
+/* runs the tests on the mutants of a *.mutants.adj.viable file,
+   several at a time, the way get_data_mutation_junit.sh does it one
+   by one: each worker has a tree of its own hard linked to the classes,
+   where the link to the class of a mutant is replaced by a copy of the
+   mutant and then put back, so that installing a mutant takes the same
+   time whatever the number of classes, and each mutant writes
+   its outputs to <outputs dir>/M<fault>.  The outputs are compared
+   by size and hash with the stored ones, hashed once at the start, an
+   output with the size and hash of the stored one is compared with it
+   as cmp -s does, and the Version/Test/Exposed records are written for
+   combine_fault_data.  With -hash_only equal hashes are taken for equal
+   outputs without reading the stored one: two different outputs with
+   the same 64-bit hash are then recorded as not exposing the fault.
+
+   The mutants are dealt to the workers in turn; a worker runs its own
+   from the back of its queue, and once they are done takes mutants
+   from the front of the queues of the others */
+
+typedef struct
+{
+  pthread_mutex_t lock;
+  int * mutants;		/* indices in the mutants file */
+  int head, tail;
+} queue;
+
+typedef struct
+{
+  int id;
+  char * classes;		/* the copy of the classes of the worker */
+} worker;
+
+static char * * mutants;
+static int num_mutants, fault_start;
+static char * mutants_dir, * classes_dir, * work_dir, * stored_dir,
+  * outputs_dir, * command, * testid_file;
+static line_slab testids;
+
+/* the sizes and hashes of the stored outputs, computed once */
+static long long * stored_sizes;
+static unsigned long long * stored_hashes;
+static int flag_hash_only;
+
+static queue * queues;
+static int num_workers;
+
+static FILE * records;
+static pthread_mutex_t records_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void * allocate(int size)
+{
+  void * p;
+
+  p = malloc(MAX(size, 1));
+  if (p == NULL)
+    {
+      fprintf(stderr, "Cannot allocate memory\n");
+      exit(-1);
+    }
+
+  return p;
+}
+
+static char * concat(char * a, char * b, char * c)
+{
+  char * s;
+
+  s = allocate(strlen(a) + strlen(b) + strlen(c) + 1);
+  sprintf(s, "%s%s%s", a, b, c);
+
+  return s;
+}
+
+/* runs 'argv' and waits for it, returns its exit status */
+static int run(char * * argv)
+{
+  pid_t pid;
+  int status;
+
+  pid = fork();
+  if (pid < 0)
+    {
+      fprintf(stderr, "Cannot fork for %s\n", argv[0]);
+      return -1;
+    }
+  if (pid == 0)
+    {
+      execvp(argv[0], argv);
+      _exit(127);
+    }
+
+  while (waitpid(pid, &status, 0) < 0)
+    if (errno != EINTR)
+      return -1;
+
+  return (WIFEXITED(status)) ? (WEXITSTATUS(status)) : (-1);
+}
+
+/* copies the file 'from' to a new file 'to' */
+static int copy_file(char * from, char * to)
+{
+  static const int size = 1 << 16;
+  FILE * in, * out;
+  char * buffer;
+  size_t n;
+  int failed;
+
+  in = fopen(from, "rb");
+  if (in == NULL)
+    return -1;
+  out = fopen(to, "wb");
+  if (out == NULL)
+    {
+      fclose(in);
+      return -1;
+    }
+
+  buffer = allocate(size);
+  failed = 0;
+  while ((n = fread(buffer, 1, size, in)) > 0)
+    if (fwrite(buffer, 1, n, out) != n)
+      failed = 1;
+  failed |= ferror(in);
+  fclose(in);
+  failed |= (fclose(out) != 0);
+  free(buffer);
+
+  return failed ? -1 : 0;
+}
+
+/* puts the file 'from' at 'to' as a hard link, or as a copy where
+   they are on different file systems */
+static int link_file(char * from, char * to)
+{
+  if (link(from, to) == 0)
+    return 0;
+  if ((errno != EXDEV) && (errno != EPERM) && (errno != EMLINK))
+    return -1;
+
+  return copy_file(from, to);
+}
+
+/* builds 'to' as a farm of hard links to the files of the tree
+   'from': only the directories are created, so it costs one entry
+   per file however large the classes are */
+static int link_tree(char * from, char * to)
+{
+  DIR * dir;
+  struct dirent * entry;
+  struct stat st;
+  char * source, * target;
+  int failed;
+
+  if ((mkdir(to, 0777) != 0) && (errno != EEXIST))
+    return -1;
+  dir = opendir(from);
+  if (dir == NULL)
+    return -1;
+
+  failed = 0;
+  while (! failed && ((entry = readdir(dir)) != NULL))
+    {
+      if ((strcmp(entry->d_name, ".") == 0) || (strcmp(entry->d_name, "..") == 0))
+	continue;
+      source = concat(from, "/", entry->d_name);
+      target = concat(to, "/", entry->d_name);
+      if (stat(source, &st) != 0)
+	failed = 1;
+      else if (S_ISDIR(st.st_mode))
+	failed = (link_tree(source, target) != 0);
+      else
+	failed = (link_file(source, target) != 0);
+      free(source);
+      free(target);
+    }
+  closedir(dir);
+
+  return failed ? -1 : 0;
+}
+
+/* replaces the file at 'target' by a copy of 'from': the link to the
+   original classes is broken first so that they are never written */
+static int install_file(char * from, char * target)
+{
+  if ((unlink(target) != 0) && (errno != ENOENT))
+    return -1;
+
+  return copy_file(from, target);
+}
+
+/* puts the original class back as a link, or takes the mutant away
+   when there was no such class */
+static int restore_file(char * original, char * target)
+{
+  if ((unlink(target) != 0) && (errno != ENOENT))
+    return -1;
+  if (access(original, F_OK) != 0)
+    return 0;
+
+  return link_file(original, target);
+}
+
+/* the command of a mutant, with %c the classes of the worker, %o the
+   output directory, %t the testId file and %f the fault number */
+static char * expand_command(char * classes, char * output, int fault)
+{
+  char fault_str[32];
+  char * s, * p, * arg;
+  int n;
+
+  sprintf(fault_str, "%i", fault);
+  n = strlen(command) + 1;
+  for (p = strchr(command, '%'); p != NULL; p = strchr(p + 1, '%'))
+    n += strlen(classes) + strlen(output) + strlen(testid_file) + 32;
+  s = allocate(n);
+
+  for (p = command, n = 0; *p != 0; p++)
+    {
+      arg = NULL;
+      if ((p[0] == '%') && (p[1] != 0))
+	{
+	  switch (p[1])
+	    {
+	    case 'c': arg = classes; break;
+	    case 'o': arg = output; break;
+	    case 't': arg = testid_file; break;
+	    case 'f': arg = fault_str; break;
+	    case '%': arg = "%"; break;
+	    }
+	}
+      if (arg != NULL)
+	{
+	  strcpy(s + n, arg);
+	  n += strlen(arg);
+	  p++;
+	}
+      else
+	s[n++] = *p;
+    }
+  s[n] = 0;
+
+  return s;
+}
+
+/* the class a mutant replaces: file.M<n> is file.class */
+static char * class_name(char * mutant)
+{
+  char * s, * p, * q;
+
+  s = allocate(strlen(mutant) + 8);
+  strcpy(s, mutant);
+  for (p = strstr(s, ".M"); p != NULL; p = strstr(p + 1, ".M"))
+    {
+      for (q = p + 2; (*q >= '0') && (*q <= '9'); q++);
+      if (q > p + 2)
+	{
+	  memmove(p + 6, q, strlen(q) + 1);
+	  memcpy(p, ".class", 6);
+	  break;
+	}
+    }
+
+  return s;
+}
+
+static void run_mutant(worker * w, int m)
+{
+  char fault_str[32];
+  char * mutant, * klass, * mutant_file, * target, * original, * output,
+    * cmd, * out_file, * stored_file;
+  char * argv[4];
+  int i, fault, status, exposed;
+  struct stat st;
+  unsigned long long hash;
+  long long out_size;
+  FILE * f;
+  char * text;
+  size_t size;
+
+  fault = fault_start + m;
+  mutant = mutants[m];
+  mutant_file = concat(mutants_dir, "/", mutant);
+  if (access(mutant_file, R_OK) != 0)
+    {
+      free(mutant_file);
+      return;
+    }
+
+  klass = class_name(mutant);
+  target = concat(w->classes, "/", klass);
+  original = concat(classes_dir, "/", klass);
+  sprintf(fault_str, "/M%i", fault);
+  output = concat(outputs_dir, fault_str, "");
+
+  fprintf(stderr, "worker %i: mutant %s as fault %i\n", w->id, mutant, fault);
+
+  /* a fresh output directory, and the mutant in the classes */
+  argv[0] = "rm";
+  argv[1] = "-rf";
+  argv[2] = output;
+  argv[3] = NULL;
+  run(argv);
+  if ((mkdir(output, 0777) != 0) || (install_file(mutant_file, target) != 0))
+    {
+      fprintf(stderr, "Cannot set up mutant %s in %s\n", mutant, w->classes);
+      exit(-1);
+    }
+
+  cmd = expand_command(w->classes, output, fault);
+  argv[0] = "/bin/sh";
+  argv[1] = "-c";
+  argv[2] = cmd;
+  argv[3] = NULL;
+  status = run(argv);
+  if (status != 0)
+    fprintf(stderr, "worker %i: the tests of fault %i exited with %i\n",
+	    w->id, fault, status);
+
+  /* the original class goes back */
+  if (restore_file(original, target) != 0)
+    {
+      fprintf(stderr, "Cannot restore %s in %s\n", klass, w->classes);
+      exit(-1);
+    }
+
+  /* the records of a mutant are written together */
+  f = open_memstream(&text, &size);
+  if (f == NULL)
+    {
+      fprintf(stderr, "Cannot allocate memory\n");
+      exit(-1);
+    }
+  for (i = 0; i < testids.numlines; i++)
+    {
+      out_file = concat(output, "/t", testids.lines[i]);
+      exposed = (stored_sizes[i] < 0) || (stat(out_file, &st) != 0)
+	|| (st.st_size != stored_sizes[i])
+	|| (hash_file(out_file, &hash, &out_size) != 0)
+	|| (hash != stored_hashes[i]);
+      if (! exposed && ! flag_hash_only)
+	{
+	  stored_file = concat(stored_dir, "/t", testids.lines[i]);
+	  exposed = files_differ(out_file, stored_file);
+	  free(stored_file);
+	}
+      fprintf(f, "Version:%i Test:%i Exposed:%i\n", fault, i, exposed);
+      free(out_file);
+    }
+  fclose(f);
+
+  pthread_mutex_lock(&records_lock);
+  fwrite(text, 1, size, records);
+  fflush(records);
+  pthread_mutex_unlock(&records_lock);
+
+  free(text);
+  free(cmd);
+  free(output);
+  free(original);
+  free(target);
+  free(klass);
+  free(mutant_file);
+}
+
+/* the next mutant of worker 'k': the back of its queue, or the front
+   of the queue of another one, -1 once every queue is empty */
+static int next_mutant(int k)
+{
+  queue * q;
+  int i, m;
+
+  q = &queues[k];
+  pthread_mutex_lock(&q->lock);
+  m = (q->head < q->tail) ? (q->mutants[--q->tail]) : (-1);
+  pthread_mutex_unlock(&q->lock);
+
+  for (i = 1; (m < 0) && (i < num_workers); i++)
+    {
+      q = &queues[(k + i) % num_workers];
+      pthread_mutex_lock(&q->lock);
+      if (q->head < q->tail)
+	m = q->mutants[q->head++];
+      pthread_mutex_unlock(&q->lock);
+    }
+
+  return m;
+}
+
+static void * work(void * arg)
+{
+  worker * w = arg;
+  int m;
+
+  while ((m = next_mutant(w->id)) >= 0)
+    run_mutant(w, m);
+
+  return NULL;
+}
+
+static void usage(char * name)
+{
+  printf("%s <mutants file> <mutants dir> <classes dir> <work dir> <testId file> <stored outputs dir> <outputs dir> <command> [-fault_start=<n>] [-jobs=<n>] [-records=<file>] [-hash_only]\n", name);
+  printf("\tthe command runs the tests, with %%c the classes, %%o the output directory, %%t the testId file and %%f the fault\n");
+  exit(-1);
+}
+
+int main(int argc, char * * argv)
+{
+  line_slab mutants_file;
+  worker * workers;
+  pthread_t * threads;
+  char * records_file, * stored_file;
+  char id[32];
+  int i, jobs;
+
+  if (argc < 9)
+    usage(argv[0]);
+
+  mutants_dir = argv[2];
+  classes_dir = argv[3];
+  work_dir = argv[4];
+  testid_file = argv[5];
+  stored_dir = argv[6];
+  outputs_dir = argv[7];
+  command = argv[8];
+  fault_start = 1;
+  jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  records_file = NULL;
+  for (i = 9; i < argc; i++)
+    {
+      if (strncmp(argv[i], "-fault_start=", 13) == 0)
+	sscanf(argv[i], "-fault_start=%i", &fault_start);
+      else if (strncmp(argv[i], "-jobs=", 6) == 0)
+	sscanf(argv[i], "-jobs=%i", &jobs);
+      else if (strncmp(argv[i], "-records=", 9) == 0)
+	records_file = argv[i] + 9;
+      else if (strcmp(argv[i], "-hash_only") == 0)
+	flag_hash_only = 1;
+      else
+	{
+	  printf("Invalid argument %s\n", argv[i]);
+	  usage(argv[0]);
+	}
+    }
+
+  if (load_line_slab(argv[1], &mutants_file) < 0)
+    {
+      printf("Cannot open file %s for reading\n", argv[1]);
+      exit(-1);
+    }
+  mutants = mutants_file.lines;
+  num_mutants = mutants_file.numlines;
+
+  if (load_line_slab(testid_file, &testids) < 0)
+    {
+      printf("Cannot open file %s for reading\n", testid_file);
+      exit(-1);
+    }
+
+  /* a missing stored output exposes every mutant, as with cmp -s */
+  stored_sizes = allocate(MAX(testids.numlines, 1) * sizeof(long long));
+  stored_hashes = allocate(MAX(testids.numlines, 1) * sizeof(unsigned long long));
+  for (i = 0; i < testids.numlines; i++)
+    {
+      stored_file = concat(stored_dir, "/t", testids.lines[i]);
+      if (hash_file(stored_file, &stored_hashes[i], &stored_sizes[i]) != 0)
+	stored_sizes[i] = -1;
+      free(stored_file);
+    }
+
+  records = stdout;
+  if (records_file != NULL)
+    {
+      records = fopen(records_file, "a");
+      if (records == NULL)
+	{
+	  printf("Cannot open file %s for writing\n", records_file);
+	  exit(-1);
+	}
+    }
+
+  num_workers = MAX(MIN(jobs, num_mutants), 1);
+  workers = allocate(num_workers * sizeof(worker));
+  queues = allocate(num_workers * sizeof(queue));
+  threads = allocate(num_workers * sizeof(pthread_t));
+  mkdir(work_dir, 0777);
+  for (i = 0; i < num_workers; i++)
+    {
+      sprintf(id, "/w%i", i);
+      workers[i].id = i;
+      workers[i].classes = concat(work_dir, id, "");
+      pthread_mutex_init(&queues[i].lock, NULL);
+      queues[i].mutants = allocate(((num_mutants + num_workers - 1) / num_workers) * sizeof(int));
+      queues[i].head = 0;
+      queues[i].tail = 0;
+
+      /* the classes are linked once per worker, not copied per mutant */
+      argv[0] = "rm";
+      argv[1] = "-rf";
+      argv[2] = workers[i].classes;
+      argv[3] = NULL;
+      run(argv);
+      if (link_tree(classes_dir, workers[i].classes) != 0)
+	{
+	  fprintf(stderr, "Cannot link %s to %s\n", classes_dir, workers[i].classes);
+	  exit(-1);
+	}
+    }
+
+  /* the mutants are dealt from the last one down, the worker k gets
+     the mutants m with (num_mutants - 1 - m) % n == k; each queue goes
+     from the largest to the smallest, so that the worker pops its
+     mutants from the back of the queue in increasing order, and a
+     worker with an empty queue takes the largest one left from the
+     front of the queue of the next worker which has any (next_mutant) */
+  for (i = 0; i < num_mutants; i++)
+    {
+      queue * q = &queues[i % num_workers];
+      q->mutants[q->tail++] = num_mutants - 1 - i;
+    }
+
+  for (i = 0; i < num_workers; i++)
+    if (pthread_create(&threads[i], NULL, work, &workers[i]) != 0)
+      {
+	fprintf(stderr, "Cannot create thread\n");
+	exit(-1);
+      }
+  for (i = 0; i < num_workers; i++)
+    pthread_join(threads[i], NULL);
+
+  if (records != stdout)
+    fclose(records);
+
+  for (i = 0; i < num_workers; i++)
+    {
+      pthread_mutex_destroy(&queues[i].lock);
+      free(queues[i].mutants);
+      free(workers[i].classes);
+    }
+  free(queues);
+  free(workers);
+  free(threads);
+  free_line_slab(&mutants_file);
+  free(stored_sizes);
+  free(stored_hashes);
+  free_line_slab(&testids);
+
+  return 0;
+}
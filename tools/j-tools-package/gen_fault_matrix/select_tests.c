@@ -0,0 +1,442 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "defs.h"
+#include "file_utils.h"
+
+/* selects the tests of a universe which reach the code changed between
+   two versions, from the records of "adiff -batch" and a coverage
+   matrix.  The coverage matrix has the format of a fault matrix where
+   "version" f is function f of the functions file: a test exposes f
+   when it executes it.  A line of the functions file is a function
+   name, or "<file>:<function>" where <file> is the name of the source
+   file without its directory.
+
+   The rows of the coverage matrix by function are the inverted index:
+   the selection is the union of the rows of the changed and deleted
+   functions.  A change outside of the functions of a file selects the
+   tests of all of the functions of the file, an "error" record or a
+   file without functions in the list selects every test.  The
+   selected tests are ordered by the changed functions they reach not
+   reached by the tests before them, as the additional order of
+   prioritize_tests.  The lines of the universe are written to stdout
+   or to -output=<file>, or their numbers with -ids, and the messages
+   to stderr */
+
+static int tests, functions;
+static char * * names;		/* the lines of the functions file */
+static char * * short_names;	/* the function part of each line */
+static int * next_same;		/* the next function with the same short name */
+static int * by_name, * by_short_name, table_size;
+static bitword * selected;	/* the tests */
+static bitword * changed;	/* the functions */
+static int selected_all, unknown;
+
+static void * allocate(int n, int size)
+{
+  void * p;
+
+  p = calloc((n > 0) ? n : 1, size);
+  if (p == NULL)
+    {
+      printf("Cannot allocate memory for %i functions\n", functions);
+      exit(-1);
+    }
+
+  return p;
+}
+
+static unsigned int hash_string(char * s, int n)
+{
+  unsigned int h = 2166136261u;
+  int i;
+
+  for (i = 0; (i < n) && (s[i] != 0); i++)
+    h = (h ^ (unsigned char) s[i]) * 16777619u;
+
+  return h;
+}
+
+/* the function numbered 'f' + 1 in the table, by its first n characters */
+static void insert(int * table, char * * keys, int f, int n)
+{
+  int slot;
+
+  slot = hash_string(keys[f], n) & (table_size - 1);
+  while (table[slot] != 0)
+    {
+      if (strcmp(keys[table[slot] - 1], keys[f]) == 0)
+	return;
+      slot = (slot + 1) & (table_size - 1);
+    }
+  table[slot] = f + 1;
+}
+
+static int lookup(int * table, char * * keys, char * key)
+{
+  int slot;
+
+  slot = hash_string(key, INPUTMAX) & (table_size - 1);
+  while (table[slot] != 0)
+    {
+      if (strcmp(keys[table[slot] - 1], key) == 0)
+	return table[slot] - 1;
+      slot = (slot + 1) & (table_size - 1);
+    }
+
+  return -1;
+}
+
+static void load_functions(char * file, line_slab * slab)
+{
+  char * colon;
+  int f, last;
+
+  if (load_line_slab(file, slab) < 0)
+    {
+      printf("Cannot open file %s for reading\n", file);
+      exit(-1);
+    }
+  names = slab->lines;
+  if (slab->numlines < functions)
+    {
+      printf("Functions file %s has %i functions, the coverage matrix %i\n",
+	     file, slab->numlines, functions);
+      exit(-1);
+    }
+
+  short_names = allocate(functions, sizeof(char *));
+  next_same = allocate(functions, sizeof(int));
+  table_size = 16;
+  while (table_size < 2 * functions)
+    table_size *= 2;
+  by_name = allocate(table_size, sizeof(int));
+  by_short_name = allocate(table_size, sizeof(int));
+
+  for (f = 0; f < functions; f++)
+    {
+      /* a C++ or Java name can hold "::", only a single colon
+	 before it is taken for the file */
+      colon = strchr(names[f], ':');
+      short_names[f] = ((colon != NULL) && (colon[1] != ':')) ? (colon + 1) : (names[f]);
+      insert(by_name, names, f, INPUTMAX);
+    }
+
+  /* the functions with the same short name are chained from the last
+     one, which is the one in the table */
+  for (f = 0; f < functions; f++)
+    {
+      last = lookup(by_short_name, short_names, short_names[f]);
+      next_same[f] = last;
+      if (last >= 0)
+	{
+	  /* move the head of the chain to 'f' */
+	  int slot = hash_string(short_names[f], INPUTMAX) & (table_size - 1);
+	  while (by_short_name[slot] != last + 1)
+	    slot = (slot + 1) & (table_size - 1);
+	  by_short_name[slot] = f + 1;
+	}
+      else
+	insert(by_short_name, short_names, f, INPUTMAX);
+    }
+}
+
+static void select_function(int f)
+{
+  BITSET_SET(changed, f);
+  bitset_or(selected, exposing_tests(f + 1), test_set_words());
+}
+
+static void select_all(void)
+{
+  int t;
+
+  for (t = 0; t < tests; t++)
+    BITSET_SET(selected, t);
+  selected_all = 1;
+}
+
+/* the functions of 'file', given without its directory */
+static void select_file(char * file)
+{
+  int f, n, found;
+
+  n = strlen(file);
+  found = 0;
+  for (f = 0; f < functions; f++)
+    if ((short_names[f] != names[f]) && (short_names[f] - names[f] == n + 1)
+	&& (strncmp(names[f], file, n) == 0))
+      {
+	select_function(f);
+	found = 1;
+      }
+
+  if (! found)
+    {
+      fprintf(stderr, "Warning: no functions of file %s in the functions file, selecting all tests\n", file);
+      select_all();
+    }
+}
+
+static char * base_name(char * path)
+{
+  char * slash;
+
+  slash = strrchr(path, '/');
+
+  return (slash != NULL) ? (slash + 1) : (path);
+}
+
+/* "<file>\t<function>\t<kind>\t<line1>\t<line2>"; the qualified name
+   is looked up first, then every function listed without a file
+   under the name */
+static void select_record(char * record)
+{
+  char * fields[5], * key, * p;
+  int i, f, found;
+
+  p = record;
+  for (i = 0; i < 5; i++)
+    {
+      fields[i] = p;
+      p = (p != NULL) ? (strchr(p, '\t')) : (NULL);
+      if (p != NULL)
+	*p++ = 0;
+    }
+  if (fields[2] == NULL)
+    return;
+
+  if (strcmp(fields[2], "error") == 0)
+    {
+      fprintf(stderr, "Warning: %s could not be compared, selecting all tests\n", fields[0]);
+      select_all();
+      return;
+    }
+
+  if (strcmp(fields[2], "missing") == 0)
+    {
+      select_file(base_name(fields[0]));
+      return;
+    }
+
+  if ((strcmp(fields[2], "changed") != 0) && (strcmp(fields[2], "deleted") != 0))
+    return;
+
+  if (strcmp(fields[1], "#DATA DECLARATIONS OUTSIDE OF FUNCTIONS#") == 0)
+    {
+      select_file(base_name(fields[0]));
+      return;
+    }
+
+  key = allocate(strlen(base_name(fields[0])) + strlen(fields[1]) + 2, sizeof(char));
+  sprintf(key, "%s:%s", base_name(fields[0]), fields[1]);
+  f = lookup(by_name, names, key);
+  free(key);
+  if (f >= 0)
+    {
+      select_function(f);
+      return;
+    }
+
+  /* a function with a file which is still unknown here is one of
+     another file */
+  found = 0;
+  for (f = lookup(by_short_name, short_names, fields[1]); f >= 0; f = next_same[f])
+    if (short_names[f] == names[f])
+      {
+	select_function(f);
+	found = 1;
+      }
+
+  /* the function was never executed, or is not in the list */
+  if (! found)
+    unknown++;
+}
+
+typedef struct
+{
+  int gain, test;
+} heap_entry;
+
+static int heap_before(heap_entry * x, heap_entry * y)
+{
+  return (x->gain > y->gain) || ((x->gain == y->gain) && (x->test < y->test));
+}
+
+static void heap_down(heap_entry * heap, int n, int i)
+{
+  heap_entry tmp;
+  int c;
+
+  while ((c = 2 * i + 1) < n)
+    {
+      if ((c + 1 < n) && heap_before(&heap[c + 1], &heap[c]))
+	c++;
+      if (! heap_before(&heap[c], &heap[i]))
+	break;
+      tmp = heap[i];
+      heap[i] = heap[c];
+      heap[c] = tmp;
+      i = c;
+    }
+}
+
+/* the selected tests by the changed functions they reach that the
+   tests before them do not, with the heap of prioritize_tests; the
+   tests which reach no changed function follow by their numbers */
+static int order_selected(int * order)
+{
+  heap_entry * heap;
+  bitword * uncovered;
+  int t, n, gain, placed;
+
+  heap = allocate(tests, sizeof(heap_entry));
+  uncovered = bitset_alloc(functions);
+  bitset_copy(uncovered, changed, version_set_words());
+
+  placed = 0;
+  while (1)
+    {
+      n = 0;
+      for (t = bitset_next(selected, tests, 0); t >= 0; t = bitset_next(selected, tests, t + 1))
+	{
+	  heap[n].gain = bitset_and_count(exposed_faults(t), uncovered, version_set_words());
+	  heap[n].test = t;
+	  if (heap[n].gain > 0)
+	    n++;
+	}
+      if (n == 0)
+	break;
+      for (t = n / 2 - 1; t >= 0; t--)
+	heap_down(heap, n, t);
+
+      while ((n > 0) && (heap[0].gain > 0))
+	{
+	  gain = bitset_and_count(exposed_faults(heap[0].test), uncovered,
+				  version_set_words());
+	  if (gain < heap[0].gain)
+	    {
+	      heap[0].gain = gain;
+	      heap_down(heap, n, 0);
+	      continue;
+	    }
+
+	  order[placed++] = heap[0].test;
+	  BITSET_CLEAR(selected, heap[0].test);
+	  bitset_andnot(uncovered, exposed_faults(heap[0].test), version_set_words());
+	  heap[0] = heap[--n];
+	  heap_down(heap, n, 0);
+	}
+
+      /* every changed function is reached, again for the other tests */
+      bitset_copy(uncovered, changed, version_set_words());
+    }
+
+  for (t = bitset_next(selected, tests, 0); t >= 0; t = bitset_next(selected, tests, t + 1))
+    order[placed++] = t;
+
+  free(heap);
+  bitset_free(uncovered);
+
+  return placed;
+}
+
+static void usage(char * name)
+{
+  printf("%s <coverage matrix> <functions file> <adiff records> [-output=<file>] [-ids]\n", name);
+  exit(-1);
+}
+
+int main(int argc, char * * argv)
+{
+  int i, n, flag_ids;
+  char * output_file, * line;
+  int * order;
+  line_slab slab, records;
+  FILE * out;
+
+  if (argc < 4)
+    usage(argv[0]);
+
+  output_file = NULL;
+  flag_ids = 0;
+  for (i = 4; i < argc; i++)
+    {
+      if (strncmp(argv[i], "-output=", 8) == 0)
+	output_file = argv[i] + 8;
+      else if (strcmp(argv[i], "-ids") == 0)
+	flag_ids = 1;
+      else
+	{
+	  printf("Invalid argument %s\n", argv[i]);
+	  usage(argv[0]);
+	}
+    }
+
+  if (! read_matrix(argv[1]))
+    exit(-1);
+
+  tests = number_of_tests();
+  functions = number_of_versions();
+  load_functions(argv[2], &slab);
+
+  selected = bitset_alloc(tests);
+  changed = bitset_alloc(functions);
+  if (load_line_slab(strcmp(argv[3], "-") == 0 ? "/dev/stdin" : argv[3], &records) < 0)
+    {
+      printf("Cannot open file %s for reading\n", argv[3]);
+      exit(-1);
+    }
+  for (i = 0; i < records.numlines; i++)
+    select_record(records.lines[i]);
+
+  order = allocate(tests, sizeof(int));
+  n = order_selected(order);
+
+  out = stdout;
+  if (output_file != NULL)
+    {
+      out = fopen(output_file, "w");
+      if (out == NULL)
+	{
+	  printf("Cannot open file %s for writing\n", output_file);
+	  exit(-1);
+	}
+    }
+
+  line = allocate(INPUTMAX, sizeof(char));
+  for (i = 0; i < n; i++)
+    {
+      if (flag_ids)
+	fprintf(out, "%i\n", order[i]);
+      else
+	{
+	  fault_matrix_copy_universe_line(order[i], line);
+	  fprintf(out, "%s\n", line);
+	}
+    }
+  free(line);
+
+  if (output_file != NULL)
+    fclose(out);
+
+  /* the summary goes to stderr when the lines go to stdout */
+  fprintf((output_file != NULL) ? stdout : stderr,
+	  "Selected %i of %i tests for %i changed functions%s\n", n, tests,
+	  bitset_count(changed, version_set_words()),
+	  selected_all ? " (all tests)" : "");
+  if (unknown > 0)
+    fprintf(stderr, "Warning: %i changed functions are not in the functions file\n", unknown);
+
+  free(order);
+  free(short_names);
+  free(next_same);
+  free(by_name);
+  free(by_short_name);
+  bitset_free(selected);
+  bitset_free(changed);
+  free_line_slab(&slab);
+  free_line_slab(&records);
+
+  return 0;
+}
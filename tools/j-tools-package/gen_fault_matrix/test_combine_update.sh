@@ -0,0 +1,50 @@
+#!/bin/sh
+# checks "combine_fault_data -update" with a universe which starts with
+# a CLASSPATH line: the new tests get their own universe lines, and the
+# CLASSPATH line is kept, in text and in binary matrices
+
+dir=`mktemp -d /tmp/test_combine_update.XXXXXX` || exit 1
+trap 'rm -rf ${dir}' 0
+failed=0
+
+check()
+{
+  if ! cmp -s ${1} ${2}
+  then echo "FAILED: ${3}"
+       diff ${1} ${2}
+       failed=1
+  fi
+}
+
+printf 'CLASSPATH=/x\n-P t0\n-P t1\n-P t2\n' > ${dir}/universe
+printf 'CLASSPATH=/x\n-P t0\n-P t1\n-P t2\n-P t3\n' > ${dir}/universe2
+printf 'Version:1 Test:0 Exposed:1\nVersion:2 Test:2 Exposed:1\n' > ${dir}/data
+printf 'Version:1 Test:3 Exposed:1\nVersion:2 Test:1 Exposed:1\n' > ${dir}/data2
+
+# the matrix written by combine_fault_data from both data files at once
+cat ${dir}/data ${dir}/data2 > ${dir}/all
+./combine_fault_data ${dir}/all ${dir}/universe2 ${dir}/expected > /dev/null || exit 1
+
+./combine_fault_data ${dir}/data ${dir}/universe ${dir}/matrix > /dev/null || exit 1
+./combine_fault_data -update ${dir}/data2 ${dir}/matrix ${dir}/universe2 > /dev/null || failed=1
+check ${dir}/expected ${dir}/matrix "update of a text matrix"
+
+# a binary matrix, converted back to text
+./combine_fault_data ${dir}/data ${dir}/universe ${dir}/matrix > /dev/null || exit 1
+./convert_fault_matrix ${dir}/matrix ${dir}/binary > /dev/null || exit 1
+./combine_fault_data -update ${dir}/data2 ${dir}/binary ${dir}/universe2 > /dev/null || failed=1
+./convert_fault_matrix ${dir}/binary ${dir}/text > /dev/null || exit 1
+check ${dir}/expected ${dir}/text "update of a binary matrix"
+
+# a universe without the lines of the new tests is refused
+printf 'CLASSPATH=/x\n-P t0\n-P t1\n-P t2\n' > ${dir}/short
+./combine_fault_data ${dir}/data ${dir}/universe ${dir}/matrix > /dev/null || exit 1
+if ./combine_fault_data -update ${dir}/data2 ${dir}/matrix ${dir}/short > /dev/null
+then echo "FAILED: update with a short universe"
+     failed=1
+fi
+
+if test ${failed} -eq 0
+then echo "combine_fault_data -update: ok"
+fi
+exit ${failed}
@@ -0,0 +1,126 @@
+/* bit sets packed into 64-bit words,
+   used for the fault matrix and the sets of tests and faults
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bitset.h"
+
+/* returns a set of 'nbits' cleared bits, NULL if there is no memory,
+   a spare word is allocated so that empty sets are not NULL either */
+bitword * bitset_alloc(int nbits)
+{
+  return (bitword *) calloc(BITSET_WORDS(nbits) + 1, sizeof(bitword));
+}
+
+void bitset_free(bitword * set)
+{
+  free(set);
+}
+
+void bitset_zero(bitword * set, int nwords)
+{
+  memset(set, 0, nwords * sizeof(bitword));
+}
+
+void bitset_copy(bitword * dest, const bitword * src, int nwords)
+{
+  memcpy(dest, src, nwords * sizeof(bitword));
+}
+
+int bitset_count(const bitword * set, int nwords)
+{
+  int i, n;
+
+  n = 0;
+  for (i = 0; i < nwords; i++)
+    n += __builtin_popcountll(set[i]);
+
+  return n;
+}
+
+/* the number of bits set in both 'a' and 'b' */
+int bitset_and_count(const bitword * a, const bitword * b, int nwords)
+{
+  int i, n;
+
+  n = 0;
+  for (i = 0; i < nwords; i++)
+    n += __builtin_popcountll(a[i] & b[i]);
+
+  return n;
+}
+
+/* the number of bits set in 'a' but not in 'b' */
+int bitset_andnot_count(const bitword * a, const bitword * b, int nwords)
+{
+  int i, n;
+
+  n = 0;
+  for (i = 0; i < nwords; i++)
+    n += __builtin_popcountll(a[i] & ~b[i]);
+
+  return n;
+}
+
+void bitset_or(bitword * dest, const bitword * src, int nwords)
+{
+  int i;
+
+  for (i = 0; i < nwords; i++)
+    dest[i] |= src[i];
+}
+
+void bitset_and(bitword * dest, const bitword * src, int nwords)
+{
+  int i;
+
+  for (i = 0; i < nwords; i++)
+    dest[i] &= src[i];
+}
+
+void bitset_andnot(bitword * dest, const bitword * src, int nwords)
+{
+  int i;
+
+  for (i = 0; i < nwords; i++)
+    dest[i] &= ~src[i];
+}
+
+int bitset_empty(const bitword * set, int nwords)
+{
+  int i;
+
+  for (i = 0; i < nwords; i++)
+    if (set[i] != 0)
+      return 0;
+
+  return 1;
+}
+
+/* returns the first bit set at or after 'from', -1 if there is none */
+int bitset_next(const bitword * set, int nbits, int from)
+{
+  int i, n;
+  bitword w;
+
+  if (from >= nbits)
+    return -1;
+
+  n = BITSET_WORDS(nbits);
+  i = from / BITS_PER_WORD;
+  w = set[i] & (~((bitword) 0) << (from % BITS_PER_WORD));
+
+  while (w == 0)
+    {
+      i++;
+      if (i >= n)
+	return -1;
+      w = set[i];
+    }
+
+  from = i * BITS_PER_WORD + __builtin_ctzll(w);
+
+  return (from < nbits) ? (from) : (-1);
+}
@@ -0,0 +1,29 @@
+/* bit sets packed into 64-bit words, bit i of a set is
+   bit (i % 64) of word (i / 64) */
+
+#ifndef BITSET_H
+#define BITSET_H
+
+typedef unsigned long long bitword;
+
+#define BITS_PER_WORD 64
+#define BITSET_WORDS(n) (((n) + BITS_PER_WORD - 1) / BITS_PER_WORD)
+
+#define BITSET_TEST(set, i) (((set)[(i) / BITS_PER_WORD] >> ((i) % BITS_PER_WORD)) & 1)
+#define BITSET_SET(set, i) ((set)[(i) / BITS_PER_WORD] |= ((bitword) 1) << ((i) % BITS_PER_WORD))
+#define BITSET_CLEAR(set, i) ((set)[(i) / BITS_PER_WORD] &= ~(((bitword) 1) << ((i) % BITS_PER_WORD)))
+
+bitword * bitset_alloc(int nbits);
+void bitset_free(bitword * set);
+void bitset_zero(bitword * set, int nwords);
+void bitset_copy(bitword * dest, const bitword * src, int nwords);
+int bitset_count(const bitword * set, int nwords);
+int bitset_and_count(const bitword * a, const bitword * b, int nwords);
+int bitset_andnot_count(const bitword * a, const bitword * b, int nwords);
+void bitset_or(bitword * dest, const bitword * src, int nwords);
+void bitset_and(bitword * dest, const bitword * src, int nwords);
+void bitset_andnot(bitword * dest, const bitword * src, int nwords);
+int bitset_empty(const bitword * set, int nwords);
+int bitset_next(const bitword * set, int nbits, int from);
+
+#endif
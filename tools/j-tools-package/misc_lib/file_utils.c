@@ -5,75 +5,410 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <sys/stat.h>
 #include "defs.h"
 #include "file_utils.h"
 
-int get_line_size(char * file)
+/* size of the chunks the files are read in */
+#define FILE_CHUNK (1 << 16)
+
+/* reads the whole of 'file' into one malloced buffer, NUL terminated;
+   *size gets its length.  Returns NULL if the file cannot be opened */
+char * read_file_contents(char * file, size_t * size)
 {
-  int i;
-  static char buff[MAX_READ_LINE];
   FILE * f;
+  struct stat st;
+  char * data, * tmp;
+  size_t capacity, n;
 
-  f = fopen(file, "rt");
-
+  f = fopen(file, "rb");
   if (f == NULL)
+    return NULL;
+
+  capacity = FILE_CHUNK;
+  if ((fstat(fileno(f), &st) == 0) && ((size_t) st.st_size >= capacity))
+    capacity = st.st_size + 1;
+
+  data = malloc(capacity);
+  n = 0;
+  while (data != NULL)
     {
-      printf("Cannot open file %s for reading\n", file);
+      n += fread(data + n, 1, capacity - n - 1, f);
+      if (feof(f) || ferror(f))
+	break;
+      if (capacity - n - 1 == 0)
+	{
+	  capacity *= 2;
+	  tmp = realloc(data, capacity);
+	  if (tmp == NULL)
+	    free(data);
+	  data = tmp;
+	}
+    }
+  fclose(f);
+
+  if (data == NULL)
+    {
+      printf("No enough memory for file %s\n", file);
       exit(-1);
     }
 
-  assert(f != NULL);
+  data[n] = 0;
+  *size = n;
+
+  return data;
+}
+
+int count_newlines(char * data, size_t size)
+{
+  char * p, * end;
+  int num;
+
+  num = 0;
+  end = data + size;
+  for (p = data; (p = memchr(p, '\n', end - p)) != NULL; p++)
+    num++;
 
-  fgets(buff, MAX_READ_LINE, f);
+  return num;
+}
 
-  if (strtok(buff, " \t") == NULL) 
-    i = 0;
-  else
-    i = 1;
+/* counts the fields of the first line of 'line' as strtok(" \t") does
+   on the line read by fgets, that is with its newline */
+int count_fields(char * line)
+{
+  int num, in_field;
 
-  while(strtok(NULL, " \t") != NULL) 
-    i++;
+  num = 0;
+  in_field = 0;
+  for (; *line != 0; line++)
+    {
+      if ((*line == ' ') || (*line == '\t'))
+	in_field = 0;
+      else if (! in_field)
+	{
+	  in_field = 1;
+	  num++;
+	}
+      if (*line == '\n')
+	break;
+    }
+
+  return num;
+}
+
+/* returns the number of lines of 'file', -1 if it cannot be opened */
+int count_lines(char * file)
+{
+  FILE * f;
+  static char buffer[FILE_CHUNK];
+  size_t n;
+  int num;
+
+  f = fopen(file, "rb");
+  if (f == NULL)
+    return -1;
+
+  num = 0;
+  while ((n = fread(buffer, 1, FILE_CHUNK, f)) > 0)
+    num += count_newlines(buffer, n);
 
   fclose(f);
 
+  return num;
+}
+
+/* loads 'file' into one slab; the lines are NUL terminated in place,
+   without their newline, and a last line without one is kept.
+   Returns the number of lines, -1 if the file cannot be opened */
+int load_line_slab(char * file, line_slab * slab)
+{
+  char * p, * end, * nl;
+  int i;
+
+  slab->data = read_file_contents(file, &slab->size);
+  slab->numlines = 0;
+  slab->lines = NULL;
+  if (slab->data == NULL)
+    return -1;
+
+  slab->numlines = count_newlines(slab->data, slab->size);
+  end = slab->data + slab->size;
+  if ((slab->size > 0) && (end[-1] != '\n'))
+    slab->numlines++;
+
+  slab->lines = malloc((slab->numlines + 1) * sizeof(char *));
+  if (slab->lines == NULL)
+    {
+      printf("No enough memory\n");
+      exit(-1);
+    }
+
+  p = slab->data;
+  for (i = 0; i < slab->numlines; i++)
+    {
+      slab->lines[i] = p;
+      nl = memchr(p, '\n', end - p);
+      if (nl == NULL)
+	nl = end;
+      *nl = 0;
+      p = nl + 1;
+    }
+  slab->lines[slab->numlines] = NULL;
+
+  return slab->numlines;
+}
+
+void free_line_slab(line_slab * slab)
+{
+  free(slab->data);
+  free(slab->lines);
+  slab->data = NULL;
+  slab->lines = NULL;
+  slab->size = 0;
+  slab->numlines = 0;
+}
+
+/* parses rows * cols elements of 'format' from 'text' into 'data' the
+   way fscanf would, with a fast path for the integer and the floating
+   point formats; returns the number of the elements parsed */
+static int parse_matrix(char * text, char * format, int elem_size,
+			void * data, int rows, int cols)
+{
+  int i, n, consumed;
+  long value;
+  double real;
+  char * end, * elem, save;
+  char scan_format[FIELDMAX + 4];
+
+  assert(strlen(format) < FIELDMAX);
+  sprintf(scan_format, "%s%%n", format);
+
+  n = rows * cols;
+  for (i = 0; i < n; i++)
+    {
+      elem = ((char *) data) + i * elem_size;
+      while ((*text == ' ') || (*text == '\t') || (*text == '\n')
+	     || (*text == '\r'))
+	text++;
+      if (*text == 0)
+	break;
+
+      if (((strcmp(format, "%i") == 0) || (strcmp(format, "%d") == 0))
+	  && (elem_size == sizeof(int)))
+	{
+	  value = strtol(text, &end, (format[1] == 'i') ? 0 : 10);
+	  *((int *) elem) = value;
+	}
+      else if ((strcmp(format, "%lf") == 0) && (elem_size == sizeof(double)))
+	{
+	  real = strtod(text, &end);
+	  *((double *) elem) = real;
+	}
+      else if ((strcmp(format, "%f") == 0) && (elem_size == sizeof(float)))
+	{
+	  real = strtod(text, &end);
+	  *((float *) elem) = real;
+	}
+      else
+	{
+	  /* any other format goes through sscanf, on the field alone so
+	     that sscanf does not scan the rest of the text */
+	  end = text + strcspn(text, " \t\r\n");
+	  save = *end;
+	  *end = 0;
+	  consumed = 0;
+	  if (sscanf(text, scan_format, elem, &consumed) != 1)
+	    consumed = 0;
+	  *end = save;
+	  end = text + consumed;
+	}
+
+      if (end == text)
+	break;
+      text = end;
+    }
+
   return i;
 }
 
-int getNumberLines(char * file)
+/* reads the matrix of 'format' elements in 'file', with as many
+   rows as lines and as many columns as fields in the first line, into
+   a malloced array; *rows and *cols get its size */
+void * load_file_matrix(char * file, char * format, int elem_size,
+			int * rows, int * cols)
+{
+  char * text;
+  size_t size;
+  void * data;
+  int n;
+
+  text = read_file_contents(file, &size);
+  if (text == NULL)
+    {
+      printf("Cannot open file %s for reading\n", file);
+      exit(-1);
+    }
+
+  *rows = count_newlines(text, size);
+  *cols = count_fields(text);
+
+  data = malloc(((*rows) * (*cols) + 1) * elem_size);
+  if (data == NULL)
+    {
+      printf("No enough memory for file %s\n", file);
+      exit(-1);
+    }
+
+  n = parse_matrix(text, format, elem_size, data, *rows, *cols);
+  if (n < (*rows) * (*cols))
+    {
+      printf("feof reached at row = %i, column = %i\n", n / (*cols), n % (*cols));
+      exit(0);
+    }
+
+  free(text);
+
+  return data;
+}
+
+/* whether the two files differ: files of different sizes are not
+   read, others are read until their first difference.  A file which
+   cannot be read differs from any file */
+int files_differ(char * file1, char * file2)
+{
+  FILE * f1, * f2;
+  struct stat st1, st2;
+  char * b1, * b2;
+  size_t n1, n2;
+  int differ;
+
+  if ((stat(file1, &st1) != 0) || (stat(file2, &st2) != 0)
+      || (st1.st_size != st2.st_size))
+    return 1;
+
+  f1 = fopen(file1, "rb");
+  f2 = fopen(file2, "rb");
+  b1 = malloc(FILE_CHUNK);
+  b2 = malloc(FILE_CHUNK);
+  differ = (f1 == NULL) || (f2 == NULL) || (b1 == NULL) || (b2 == NULL);
+  while (! differ)
+    {
+      n1 = fread(b1, 1, FILE_CHUNK, f1);
+      n2 = fread(b2, 1, FILE_CHUNK, f2);
+      if ((n1 != n2) || (memcmp(b1, b2, n1) != 0))
+	differ = 1;
+      if (n1 < FILE_CHUNK)
+	break;
+    }
+  if (f1 != NULL)
+    fclose(f1);
+  if (f2 != NULL)
+    fclose(f2);
+  free(b1);
+  free(b2);
+
+  return differ;
+}
+
+/* the FNV-1a hash of the contents of 'file' into *hash and its size
+   into *size; returns -1 if it cannot be read */
+int hash_file(char * file, unsigned long long * hash, long long * size)
 {
-  char c;
-  int num;
   FILE * f;
+  unsigned char * buffer;
+  size_t i, n;
 
-  num = 0;
+  f = fopen(file, "rb");
+  if (f == NULL)
+    return -1;
+  buffer = malloc(FILE_CHUNK);
+  if (buffer == NULL)
+    {
+      fclose(f);
+      return -1;
+    }
+
+  *hash = 14695981039346656037ULL;
+  *size = 0;
+  while ((n = fread(buffer, 1, FILE_CHUNK, f)) > 0)
+    {
+      for (i = 0; i < n; i++)
+	*hash = (*hash ^ buffer[i]) * 1099511628211ULL;
+      *size += n;
+    }
+  n = ferror(f);
+  fclose(f);
+  free(buffer);
+
+  return (n != 0) ? -1 : 0;
+}
+
+int get_line_size(char * file)
+{
+  int c, i, in_field;
+  FILE * f;
 
   f = fopen(file, "rt");
+
   if (f == NULL)
     {
       printf("Cannot open file %s for reading\n", file);
       exit(-1);
     }
+
   assert(f != NULL);
 
-  while (fread(&c, 1, 1, f) == 1)
+  /* as count_fields, without reading more than the first line */
+  i = 0;
+  in_field = 0;
+  while ((c = getc(f)) != EOF)
     {
+      if ((c == ' ') || (c == '\t'))
+	in_field = 0;
+      else if (! in_field)
+	{
+	  in_field = 1;
+	  i++;
+	}
       if (c == '\n')
-	num++;
+	break;
     }
 
   fclose(f);
 
+  return i;
+}
+
+int getNumberLines(char * file)
+{
+  int num;
+
+  num = count_lines(file);
+  if (num < 0)
+    {
+      printf("Cannot open file %s for reading\n", file);
+      exit(-1);
+    }
+
   return num;
 }
 
 void read_file_into_matrix(char * file, char * format, int elem_size, 
 			   void * data, int * max_rows, int * max_cols)
 {
-  int r, c, rows, cols;
-  FILE * f;
+  int rows, cols, n;
+  char * text;
+  size_t size;
 
-  rows = getNumberLines(file);
-  cols = get_line_size(file);
+  text = read_file_contents(file, &size);
+  if (text == NULL)
+    {
+      printf("Cannot open file %s for reading\n", file);
+      exit(-1);
+    }
+
+  rows = count_newlines(text, size);
+  cols = count_fields(text);
 
   if ((rows >= (*max_rows)) || (cols >= (*max_cols)))
     {
@@ -81,53 +416,39 @@ void read_file_into_matrix(char * file, char * format, int elem_size,
       exit(-1);
     }
 
-  f = fopen(file, "rt");
-  if (f == NULL)
+  n = parse_matrix(text, format, elem_size, data, rows, cols);
+  if (n < rows * cols)
     {
-      printf("Cannot open file %s for reading\n", file);
-      exit(-1);
+      printf("feof reached at row = %i, column = %i\n", n / cols, n % cols);
+      exit(0);
     }
 
-  for (r = 0; r < rows; r++)
-    for (c = 0; c < cols; c++)
-      {
-	fscanf(f, format, ((char *) data) + (cols * r + c) * elem_size);
-	if (feof(f))
-	  {
-	    printf("feof reached at row = %i, column = %i\n", r, c);
-	    exit(0);
-	  }
-      }
-
-  fclose(f);
+  free(text);
 
   (*max_rows) = rows;
   (*max_cols) = cols;
 }
 
 
+/* copies the lines of 'in', up to its last newline, to 'fout' */
 void printFile(char * in, FILE * fout)
 {
-  int i, n;
-  FILE * f;
-  static char buffer[MAX_READ_LINE + 1];
-
-  n = getNumberLines(in);
+  char * data, * last;
+  size_t size;
 
-  f = fopen(in, "r");
-  if (f == NULL)
+  data = read_file_contents(in, &size);
+  if (data == NULL)
     {
       printf("Cannot open file %s\n", in);
       exit(-1);
     }
 
-  for (i = 0; i < n; i++)
-    {
-      fgets(buffer, MAXSTR, f);
-      fputs(buffer, fout);
-    }
+  last = data + size;
+  while ((last > data) && (last[-1] != '\n'))
+    last--;
+  fwrite(data, 1, last - data, fout);
 
-  fclose(f);
+  free(data);
 }
 
 void storeLines(FILE * fout, char * * lines, int n)
@@ -155,18 +476,29 @@ int stripEndSpaces(char * * lines, int numlines)
 
 int readLinesFile(char * file, char * * * Lines)
 {
-  FILE * f;
   int numlines, i;
-  char * ptr;
   char * * lines = NULL;
-  char buffer[MAX_TEST_LINE + 10];
+  line_slab slab;
+
+  /* read the contents of the original suite file */
+  if (load_line_slab(file, &slab) < 0)
+    {
+      printf("Cannot open file %s for reading\n", file);
+      exit(-1);
+    }
+
+  /* as getNumberLines, a last line without a newline is not counted */
+  numlines = slab.numlines;
+  if ((slab.size > 0) && (slab.data[slab.size - 1] != 0))
+    numlines--;
 
-  numlines = getNumberLines(file);
   if (numlines <= 0)
     {
+      free_line_slab(&slab);
       return 0;
     }
 
+  /* every line has its own block, as freeLinesGen frees them one by one */
   lines = malloc(numlines * sizeof(char *));
   if (lines == NULL)
     {
@@ -174,32 +506,22 @@ int readLinesFile(char * file, char * * * Lines)
       exit(-1);
     }
 
-  assert(numlines < MAX_SUITE_TESTS);
-
-  /* read the contents of the original suite file */
-  f = fopen(file, "rt");
   for(i = 0; i < numlines; i++)
     {
-      buffer[0] = 0;
-      fgets(buffer, MAX_TEST_LINE, f);
-      ptr = strchr(buffer, '\n');
-      if (ptr != NULL)
-	*ptr = 0;
-
-      lines[i] = malloc((strlen(buffer) + 10) * sizeof(char));
+      lines[i] = malloc((strlen(slab.lines[i]) + 10) * sizeof(char));
       if (lines[i] == NULL)
 	{
 	  printf("No enough memory\n");
 	  exit(0);
 	}
-      strcpy(lines[i], buffer);
+      strcpy(lines[i], slab.lines[i]);
     }
 
   /*  numlines = stripEndSpaces(lines, numlines); */
 
   assert(numlines > 0);
 
-  fclose(f);
+  free_line_slab(&slab);
 
 #ifndef PRINT_LOADED_TESTS_STATUS
   printf("Loaded suite file %s with %i tests\n", file, numlines);
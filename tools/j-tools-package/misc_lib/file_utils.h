@@ -1,6 +1,28 @@
 #ifndef FILE_UTILS_H
 #define FILE_UTILS_H
 
+#include <stdio.h>
+
+/* the lines of a file loaded in one block */
+typedef struct
+{
+  char * data;		/* the file, each line NUL terminated */
+  size_t size;
+  int numlines;
+  char * * lines;	/* start of each line in data, NULL terminated */
+} line_slab;
+
+char * read_file_contents(char * file, size_t * size);
+int count_newlines(char * data, size_t size);
+int count_fields(char * line);
+int count_lines(char * file);
+int load_line_slab(char * file, line_slab * slab);
+void free_line_slab(line_slab * slab);
+void * load_file_matrix(char * file, char * format, int elem_size,
+			int * rows, int * cols);
+int files_differ(char * file1, char * file2);
+int hash_file(char * file, unsigned long long * hash, long long * size);
+
 int getNumberLines(char * file);
 int findMaxIndexInt(int * x, int n);
 int findMaxIndexDouble(double * x, int n);
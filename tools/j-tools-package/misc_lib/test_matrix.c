@@ -18,23 +18,88 @@
 #include <stdarg.h>
 #include <string.h>
 #include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include "defs.h"
 #include "test_matrix.h"
+#include "file_utils.h"
 
 /*----------------------------------------------------------------*/
 
-static int numtests;
-static int numversions;
-static int *matrix;
-static char *universe_lines[MAXULINES];
+/* the matrix used by the functions without a context argument */
+static fault_matrix default_matrix;
+
+/* Binary format, in the byte order of the machine which wrote it:
+   the header below, then the skipped lines of the universe ending 
+   with 0 if there are any, then the universe lines each ending with 0
+   (and with the newline of the text format), then 'matrix' and 
+   'matrix_by_test' exactly as they are kept in memory, at offsets 
+   which are multiples of 8 */
+
+#define MATRIX_MAGIC "FMATRIX1"
+#define MATRIX_BYTE_ORDER 0x01020304
+
+typedef struct
+{
+   char magic[8];
+   int byte_order;
+   int numversions, numtests;
+   int test_words, version_words;
+   int skipped_size;	/* the length of the skipped lines, 0 if none */
+   long long strings_offset, strings_size;
+   long long matrix_offset, matrix_by_test_offset;
+} matrix_header;
 
 int handle_error(int line_num, enum ERROR_TYPES error_type, FILE*, ... );
+static int read_matrix_file(fault_matrix *fm, char *matrixfile, int writable);
+static int read_matrix_binary(fault_matrix *fm, char *matrixfile, FILE *mfp,
+			      int writable);
+static int index_universe(fault_matrix *fm, FILE *mfp);
+static int build_universe_index(fault_matrix *fm);
 
 /*---------------------------------------------------------------------------*/
-/* Description:  read_matrix
+/* Description:  fm_init, fm_free
 
-     Reads in a matrix, into a global structure, where
-     it is accessible by other access routines.
+     A context holds one matrix, contexts are independent of each other, 
+     one context can be read while others are queried by other threads.
+     fm_free releases the matrix, the context can be read again.
+*/
+/*---------------------------------------------------------------------------*/
+
+void fm_init(fault_matrix *fm)
+{
+   memset(fm, 0, sizeof(fault_matrix));
+}
+
+void fm_free(fault_matrix *fm)
+{
+   int i;
+
+   if (fm->mapped_matrix != NULL)
+      munmap(fm->mapped_matrix, fm->mapped_length);
+   else
+   {
+      if (fm->universe_lines != NULL)
+	 for (i = 0; i < fm->numtests; i++)
+	    free(fm->universe_lines[i]);
+      bitset_free(fm->matrix);
+      bitset_free(fm->matrix_by_test);
+   }
+   free(fm->universe_lines);
+   free(fm->skipped_lines);
+   free(fm->universe_index);
+   bitset_free(fm->changed_tests);
+   fm_init(fm);
+}
+
+/*---------------------------------------------------------------------------*/
+/* Description:  fm_read, read_matrix
+
+     Reads in a matrix, into a context (the default one for read_matrix), 
+     where it is accessible by other access routines.
 
    Parameters:  takes arg naming test matrix.
 
@@ -49,71 +114,129 @@ int handle_error(int line_num, enum ERROR_TYPES error_type, FILE*, ... );
 /*---------------------------------------------------------------------------*/
 
 int read_matrix(char *matrixfile)
+{
+   return fm_read(&default_matrix, matrixfile);
+}
+
+int fm_read(fault_matrix *fm, char *matrixfile)
+{
+   return read_matrix_file(fm, matrixfile, FALSE);
+}
+
+/* lines of the universe part of a text matrix which are not tests */
+int skipped_universe_line(char *line)
+{
+   /* for java subjects, CLASSPATH setting line is skipped */
+   return (strncmp(line, "CLASSPATH", 9) == 0) || 
+      (strncmp(line, "setenv", 6) == 0);
+}
+
+/* keeps a skipped line, so that the matrix is written again with it */
+static int keep_skipped_line(fault_matrix *fm, char *line)
+{
+   char *lines;
+   size_t length;
+
+   length = (fm->skipped_lines != NULL) ? strlen(fm->skipped_lines) : 0;
+   lines = (char *) realloc(fm->skipped_lines, length + strlen(line) + 1);
+   if (lines == NULL)
+      return FALSE;
+   strcpy(lines + length, line);
+   fm->skipped_lines = lines;
+
+   return TRUE;
+}
+
+static int read_matrix_file(fault_matrix *fm, char *matrixfile, int writable)
 {
 
    FILE *mfp;
    char numstr[FILENAME_LENGTH];    
    char line[INPUTMAX];
    char *tmpstr;
-   int i,j,k;
-   int outsuitenum=0;
+   int i,j;
    int thisversion,thistest,faultvalue;
    int linelen, num_matches, line_num=0;
+   int test_words, version_words;
+   bitword *matrix, *matrix_by_test;
+
+   /* the matrix read before is replaced */
+   fm_free(fm);
 
    /* Open the matrix file. */
-   mfp = fopen(matrixfile,"rt");
+   mfp = fopen(matrixfile, (writable) ? "r+b" : "rt");
    if(mfp == NULL) return handle_error( line_num, OPEN_FILE, mfp, matrixfile );
 
+   /* binary matrices are recognized by their first bytes */
+   if (fread(numstr, 1, 8, mfp) == 8 && memcmp(numstr, MATRIX_MAGIC, 8) == 0)
+      return read_matrix_binary(fm, matrixfile, mfp, writable);
+   rewind(mfp);
+
    /* first line of the file hold number of versions */
    tmpstr = fgets( line, INPUTMAX, mfp); line_num++;
    if( tmpstr == NULL ) return handle_error( line_num, NUM_VERS_A, mfp );
 
-   num_matches = sscanf( line, "%d", &numversions);
-   if( num_matches != 1 ) return handle_error( line_num, NUM_VERS_B, mfp );
+   num_matches = sscanf( line, "%d", &fm->numversions);
+   if( num_matches != 1 || fm->numversions < 0 )
+   {
+      fm->numversions = 0;
+      return handle_error( line_num, NUM_VERS_B, mfp );
+   }
      
    /* second line of the file hold number of tests */
    tmpstr = fgets( line, INPUTMAX, mfp); line_num++;
    if (tmpstr == NULL) return handle_error( line_num, NUM_TESTS_A, mfp );
 
-   num_matches = sscanf( line, "%d", &numtests);
-   if( num_matches != 1 ) return handle_error( line_num, NUM_TESTS_B, mfp );
-   if (numtests > MAXULINES) return handle_error( line_num, TOO_MANY, mfp );
+   num_matches = sscanf( line, "%d", &fm->numtests);
+   if( num_matches != 1 || fm->numtests < 0 )
+   {
+      fm->numtests = 0;
+      return handle_error( line_num, NUM_TESTS_B, mfp );
+   }
+   fm->universe_lines = (char **) calloc(fm->numtests + 1, sizeof(char *));
+   if (fm->universe_lines == NULL)
+      return handle_error( line_num, UNIVERSE_MALLOC, mfp, 0, fm->numtests );
    
    /* now read numtests lines, each a universe file line,
       into the universe structure */ 
 
    /* now read the lines */
-   for (i=0;i<numtests;i++)
+   for (i=0;i<fm->numtests;i++)
    {
        tmpstr = fgets(line,INPUTMAX,mfp); line_num++;
        if(tmpstr == NULL) return handle_error(line_num, UNIVERSE_READ, mfp, i);
 
         /* for java subjects, CLASSPATH setting line is skipped */
-	if((line[0]=='C' && line[1]=='L' && line[2]=='A' &&
-           line[3]=='S' && line[4]=='S' && line[5]=='P' &&
-           line[6]=='A' && line[7]=='T' && line[8]=='H') ||
-	  (line[0]=='s' && line[1]=='e' && line[2]=='t' &&
-           line[3]=='e' && line[4]=='n' && line[5]=='v'))
+	if (skipped_universe_line(line))
 	{ 
+	    if (! keep_skipped_line(fm, line))
+	       return handle_error( line_num, UNIVERSE_MALLOC, mfp, i, 
+				    (int) strlen(line) + 1 );
 	    i = i - 1;
 	}
 	else {
             	/* here malloc storage for and store the line */
             	linelen = strlen(line);
-            	if ((tmpstr = (char *) malloc((linelen+1)*sizeof(char *))) == NULL)
+            	if ((tmpstr = (char *) malloc((linelen+1)*sizeof(char))) == NULL)
 	            return handle_error( line_num, UNIVERSE_MALLOC, mfp, i, linelen+1 );
             	strcpy(tmpstr,line);
-            	universe_lines[i] = tmpstr;
+            	fm->universe_lines[i] = tmpstr;
 	}
    }
 
    /* now malloc the struct to hold the matrix */
-   if ((matrix = (int *)malloc(sizeof(int)*(numtests*numversions)))== NULL)
-       return handle_error(line_num, MATRIX_MALLOC, mfp, numtests,numversions);
+   fm->test_words = test_words = BITSET_WORDS(fm->numtests);
+   fm->version_words = version_words = BITSET_WORDS(fm->numversions);
+   fm->matrix = matrix = bitset_alloc(BITS_PER_WORD * test_words * fm->numversions);
+   fm->matrix_by_test = matrix_by_test = 
+      bitset_alloc(BITS_PER_WORD * version_words * fm->numtests);
+   if ((matrix == NULL) || (matrix_by_test == NULL))
+       return handle_error(line_num, MATRIX_MALLOC, mfp, fm->numtests,
+			   fm->numversions);
 
    /* now, for each test */
 
-   for (i=1;i<=numtests;i++)
+   for (i=1;i<=fm->numtests;i++)
    {
       /* get line and read test number from it */
       tmpstr = fgets(line,INPUTMAX,mfp); line_num++;
@@ -121,9 +244,11 @@ int read_matrix(char *matrixfile)
 
       num_matches = sscanf(line,"%*7s%d:",&thistest);
       if( num_matches != 1 ) return handle_error(line_num, TEST_NUM_B, mfp, i);
+      if( thistest < 0 || thistest >= fm->numtests )
+	  return handle_error(line_num, TEST_NUM_C, mfp, thistest, fm->numtests);
 
       /* now, for each version */
-      for (j=1;j<=numversions;j++)
+      for (j=1;j<=fm->numversions;j++)
       {
          /* get line and read version number from it */
          tmpstr = fgets(line,INPUTMAX,mfp); line_num++;
@@ -133,6 +258,9 @@ int read_matrix(char *matrixfile)
          num_matches = sscanf(line,"%*1s%d:",&thisversion);
 	 if( num_matches != 1 ) 
 	     return handle_error( line_num, VERS_NUM_B, mfp, thistest, i, j );
+	 if( thisversion < 1 || thisversion > fm->numversions )
+	     return handle_error( line_num, VERS_NUM_C, mfp, thisversion, 
+				  fm->numversions );
 
          /* get line and read 0 or 1 from it */
          tmpstr = fgets(line,INPUTMAX,mfp); line_num++;
@@ -144,21 +272,636 @@ int read_matrix(char *matrixfile)
 	    return handle_error(line_num,FAULT_VAL_A,mfp,thistest,thisversion);
 
          /* fill in space in struct */ 
-         matrix[((thisversion -1)*numtests) + thistest] = faultvalue;
+	 if (faultvalue)
+	 {
+	    BITSET_SET(matrix + (thisversion - 1) * test_words, thistest);
+	    BITSET_SET(matrix_by_test + thistest * version_words, 
+		       thisversion - 1);
+	 }
+	 else
+	 {
+	    BITSET_CLEAR(matrix + (thisversion - 1) * test_words, thistest);
+	    BITSET_CLEAR(matrix_by_test + thistest * version_words, 
+			 thisversion - 1);
+	 }
 
 	 #ifdef DEBUG
          printf("setting %d (%d,%d) to %d\n",
-             ((thisversion-1)*numtests)+thistest,
+             ((thisversion-1)*fm->numtests)+thistest,
 	     thisversion,thistest,faultvalue);
 	 #endif
      }
    }
 
+   return index_universe(fm, mfp);
+}
+
+/*---------------------------------------------------------------------------*/
+/* Description:  read_matrix_binary
+
+     Maps a matrix written by write_matrix_binary, the universe lines 
+     and the bit matrices are used in place.  A writable map is 
+     shared, what fm_set_exposed changes is changed in the file.
+
+   Parameters:  matrix file name, the file open on it, and whether 
+     the map is writable.
+
+   Return value:  TRUE or FALSE.
+*/
+/*---------------------------------------------------------------------------*/
+
+static int read_matrix_binary(fault_matrix *fm, char *matrixfile, FILE *mfp,
+			      int writable)
+{
+   struct stat st;
+   matrix_header *header;
+   char *base, *p, *end;
+   long long matrix_size, matrix_by_test_size;
+   int i, numtests, numversions, test_words, version_words;
+
+   if (fstat(fileno(mfp), &st) != 0 || st.st_size < (off_t) sizeof(matrix_header))
+      return handle_error(0, BINARY_FORMAT, mfp, matrixfile);
+
+   if (writable)
+      base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, 
+		  fileno(mfp), 0);
+   else
+      base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(mfp), 0);
+   if (base == MAP_FAILED)
+      return handle_error(0, BINARY_MAP, mfp, matrixfile);
+
+   header = (matrix_header *) base;
+   numversions = header->numversions;
+   numtests = header->numtests;
+   test_words = BITSET_WORDS(numtests);
+   version_words = BITSET_WORDS(numversions);
+   matrix_size = (long long) numversions * test_words * sizeof(bitword);
+   matrix_by_test_size = (long long) numtests * version_words * sizeof(bitword);
+
+   if (header->byte_order != MATRIX_BYTE_ORDER ||
+       numversions < 0 || numtests < 0 ||
+       header->test_words != test_words ||
+       header->version_words != version_words ||
+       header->strings_offset < (long long) sizeof(matrix_header) ||
+       header->strings_size < numtests ||
+       header->strings_offset + header->strings_size > st.st_size ||
+       header->matrix_offset % 8 != 0 || header->matrix_by_test_offset % 8 != 0 ||
+       header->matrix_offset < 0 || header->matrix_by_test_offset < 0 ||
+       header->matrix_offset + matrix_size > st.st_size ||
+       header->matrix_by_test_offset + matrix_by_test_size > st.st_size)
+   {
+      munmap(base, st.st_size);
+      return handle_error(0, BINARY_FORMAT, mfp, matrixfile);
+   }
+
+   fm->universe_lines = (char **) calloc(numtests + 1, sizeof(char *));
+   if (fm->universe_lines == NULL)
+   {
+      munmap(base, st.st_size);
+      return handle_error(0, UNIVERSE_MALLOC, mfp, 0, numtests);
+   }
+
+   /* every universe line must end inside the string table */
+   p = base + header->strings_offset;
+   end = p + header->strings_size;
+   if (header->skipped_size != 0)
+   {
+      if (header->skipped_size < 0 || header->skipped_size >= end - p || 
+	  p[header->skipped_size] != 0 || 
+	  (fm->skipped_lines = strdup(p)) == NULL)
+      {
+	 munmap(base, st.st_size);
+	 free(fm->universe_lines);
+	 fm->universe_lines = NULL;
+	 return handle_error(0, BINARY_FORMAT, mfp, matrixfile);
+      }
+      p += header->skipped_size + 1;
+   }
+   for (i = 0; i < numtests; i++)
+   {
+      fm->universe_lines[i] = p;
+      p = memchr(p, 0, end - p);
+      if (p == NULL)
+      {
+	 munmap(base, st.st_size);
+	 free(fm->universe_lines);
+	 fm->universe_lines = NULL;
+	 return handle_error(0, BINARY_FORMAT, mfp, matrixfile);
+      }
+      p++;
+   }
+
+   fm->numversions = numversions;
+   fm->numtests = numtests;
+   fm->test_words = test_words;
+   fm->version_words = version_words;
+   fm->matrix = (bitword *) (base + header->matrix_offset);
+   fm->matrix_by_test = (bitword *) (base + header->matrix_by_test_offset);
+   fm->mapped_matrix = base;
+   fm->mapped_length = st.st_size;
+   fm->mapped_writable = writable;
+
+   return index_universe(fm, mfp);
+}
+
+static unsigned int hash_line(const char *line)
+{
+   unsigned int h = 2166136261u;
+
+   for (; *line != 0; line++)
+      h = (h ^ (unsigned char) *line) * 16777619u;
+
+   return h;
+}
+
+/* builds the universe index for the lines just read, and closes 'mfp' */
+static int index_universe(fault_matrix *fm, FILE *mfp)
+{
+   if (! build_universe_index(fm))
+      return handle_error(0, INDEX_MALLOC, mfp, fm->numtests);
+
+   /* the size of the matrix in the file, see fm_save */
+   fm->file_numtests = fm->numtests;
+   fm->file_numversions = fm->numversions;
+
    fclose(mfp);
 
    return TRUE;
 }
 
+static int build_universe_index(fault_matrix *fm)
+{
+   int i, slot, mask;
+
+   free(fm->universe_index);
+   fm->universe_index_size = 16;
+   while (fm->universe_index_size < 2 * fm->numtests)
+      fm->universe_index_size *= 2;
+   fm->universe_index = (int *) calloc(fm->universe_index_size, sizeof(int));
+   if (fm->universe_index == NULL)
+      return FALSE;
+
+   mask = fm->universe_index_size - 1;
+   for (i = 0; i < fm->numtests; i++)
+   {
+      slot = hash_line(fm->universe_lines[i]) & mask;
+      while (fm->universe_index[slot] != 0 &&
+	     strcmp(fm->universe_lines[fm->universe_index[slot] - 1],
+		    fm->universe_lines[i]) != 0)
+	 slot = (slot + 1) & mask;
+      if (fm->universe_index[slot] == 0)
+	 fm->universe_index[slot] = i + 1;
+   }
+
+   return TRUE;
+}
+
+/* TRUE if 'matrixfile' is in the binary format */
+int is_binary_matrix(char *matrixfile)
+{
+   char magic[8];
+   FILE *f;
+   int n;
+
+   f = fopen(matrixfile, "rb");
+   if (f == NULL) return FALSE;
+   n = fread(magic, 1, 8, f);
+   fclose(f);
+
+   return n == 8 && memcmp(magic, MATRIX_MAGIC, 8) == 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Description:  write_matrix_binary, write_matrix_text
+
+     Write the matrix of a context, in either format.
+
+   Return value:  TRUE or FALSE.
+*/
+/*---------------------------------------------------------------------------*/
+
+static int write_padding(FILE *f, long long *offset)
+{
+   char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+   size_t n;
+
+   n = (8 - *offset % 8) % 8;
+   *offset += n;
+   return fwrite(zeros, 1, n, f) == n;
+}
+
+int write_matrix_binary(char *matrixfile)
+{
+   return fm_write_binary(&default_matrix, matrixfile);
+}
+
+int fm_write_binary(fault_matrix *fm, char *matrixfile)
+{
+   FILE *f;
+   matrix_header header;
+   long long offset;
+   size_t n;
+   int i, ok;
+
+   f = fopen(matrixfile, "wb");
+   if (f == NULL)
+   {
+      fprintf(stderr, "error: unable to open %s for writing\n", matrixfile);
+      return FALSE;
+   }
+
+   memset(&header, 0, sizeof(header));
+   memcpy(header.magic, MATRIX_MAGIC, 8);
+   header.byte_order = MATRIX_BYTE_ORDER;
+   header.numversions = fm->numversions;
+   header.numtests = fm->numtests;
+   header.test_words = fm->test_words;
+   header.version_words = fm->version_words;
+   header.strings_offset = sizeof(header);
+   header.strings_size = 0;
+   if (fm->skipped_lines != NULL && fm->skipped_lines[0] != 0)
+   {
+      header.skipped_size = strlen(fm->skipped_lines);
+      header.strings_size = header.skipped_size + 1;
+   }
+   for (i = 0; i < fm->numtests; i++)
+      header.strings_size += strlen(fm->universe_lines[i]) + 1;
+   header.matrix_offset = header.strings_offset + header.strings_size;
+   header.matrix_offset += (8 - header.matrix_offset % 8) % 8;
+   header.matrix_by_test_offset = header.matrix_offset + 
+      (long long) fm->numversions * fm->test_words * sizeof(bitword);
+
+   ok = fwrite(&header, sizeof(header), 1, f) == 1;
+   offset = sizeof(header);
+   if (header.skipped_size != 0)
+   {
+      n = header.skipped_size + 1;
+      ok = ok && fwrite(fm->skipped_lines, 1, n, f) == n;
+      offset += n;
+   }
+   for (i = 0; i < fm->numtests && ok; i++)
+   {
+      n = strlen(fm->universe_lines[i]) + 1;
+      ok = fwrite(fm->universe_lines[i], 1, n, f) == n;
+      offset += n;
+   }
+   ok = ok && write_padding(f, &offset);
+   n = fm->numversions * fm->test_words;
+   ok = ok && fwrite(fm->matrix, sizeof(bitword), n, f) == n;
+   n = fm->numtests * fm->version_words;
+   ok = ok && fwrite(fm->matrix_by_test, sizeof(bitword), n, f) == n;
+
+   if (fclose(f) != 0 || ! ok)
+   {
+      fprintf(stderr, "error: unable to write %s\n", matrixfile);
+      return FALSE;
+   }
+
+   return TRUE;
+}
+
+static void write_test_block(fault_matrix *fm, FILE *f, int test)
+{
+   int j;
+
+   fprintf(f, "unitest%i:\n", test);
+   for (j = 1; j <= fm->numversions; j++)
+      fprintf(f, "v%i:\n\t%i\n", j, fm_exposed(fm, test, j));
+}
+
+int write_matrix_text(char *matrixfile)
+{
+   return fm_write_text(&default_matrix, matrixfile);
+}
+
+int fm_write_text(fault_matrix *fm, char *matrixfile)
+{
+   FILE *f;
+   int i;
+
+   f = fopen(matrixfile, "w");
+   if (f == NULL)
+   {
+      fprintf(stderr, "error: unable to open %s for writing\n", matrixfile);
+      return FALSE;
+   }
+
+   fprintf(f, "\t%i listversions\n", fm->numversions);
+   fprintf(f, "\t%i listtests\n", fm->numtests);
+
+   if (fm->skipped_lines != NULL)
+      fputs(fm->skipped_lines, f);
+   storeLines(f, fm->universe_lines, fm->numtests);
+
+   for (i = 0; i < fm->numtests; i++)
+      write_test_block(fm, f, i);
+
+   if (fclose(f) != 0)
+   {
+      fprintf(stderr, "error: unable to write %s\n", matrixfile);
+      return FALSE;
+   }
+
+   return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Description:  fm_read_update, fm_resize, fm_set_exposed, fm_save
+
+     Update a matrix file with new cells, tests and versions.  
+     fm_read_update reads a matrix to be changed, a binary one is mapped 
+     writable.  fm_resize adds tests, with their universe lines, and 
+     versions, which nothing exposes.  fm_save writes the changes back: 
+     a binary matrix of the same size is already changed in place, a 
+     text one is written again from the block of the first changed test 
+     on, and a matrix which grew is written again whole.
+
+   Return value:  TRUE or FALSE.
+*/
+/*---------------------------------------------------------------------------*/
+
+int fm_read_update(fault_matrix *fm, char *matrixfile)
+{
+   return read_matrix_file(fm, matrixfile, TRUE);
+}
+
+/* moves a mapped matrix to memory of its own */
+static int copy_mapped_matrix(fault_matrix *fm)
+{
+   char **lines;
+   bitword *matrix, *matrix_by_test;
+   int i, ok;
+
+   if (fm->mapped_matrix == NULL)
+      return TRUE;
+
+   lines = (char **) calloc(fm->numtests + 1, sizeof(char *));
+   matrix = bitset_alloc(BITS_PER_WORD * fm->test_words * fm->numversions);
+   matrix_by_test = bitset_alloc(BITS_PER_WORD * fm->version_words * fm->numtests);
+   ok = (lines != NULL) && (matrix != NULL) && (matrix_by_test != NULL);
+   for (i = 0; i < fm->numtests && ok; i++)
+      ok = (lines[i] = strdup(fm->universe_lines[i])) != NULL;
+   if (! ok)
+   {
+      for (i = 0; lines != NULL && i < fm->numtests; i++)
+	 free(lines[i]);
+      free(lines);
+      bitset_free(matrix);
+      bitset_free(matrix_by_test);
+      fprintf(stderr, "error: unable to malloc memory for matrix (%dx%d)\n",
+	      fm->numtests, fm->numversions);
+      return FALSE;
+   }
+   bitset_copy(matrix, fm->matrix, fm->test_words * fm->numversions);
+   bitset_copy(matrix_by_test, fm->matrix_by_test, 
+	       fm->version_words * fm->numtests);
+
+   munmap(fm->mapped_matrix, fm->mapped_length);
+   free(fm->universe_lines);
+   fm->universe_lines = lines;
+   fm->matrix = matrix;
+   fm->matrix_by_test = matrix_by_test;
+   fm->mapped_matrix = NULL;
+   fm->mapped_length = 0;
+   fm->mapped_writable = FALSE;
+
+   return TRUE;
+}
+
+/* 'lines' are the universe lines of the new tests, with their newline */
+int fm_resize(fault_matrix *fm, int numtests, int numversions, char **lines)
+{
+   char **universe;
+   bitword *matrix, *matrix_by_test, *changed;
+   int i, test_words, version_words;
+
+   assert(numtests >= fm->numtests && numversions >= fm->numversions);
+   if (numtests == fm->numtests && numversions == fm->numversions)
+      return TRUE;
+   if (! copy_mapped_matrix(fm))
+      return FALSE;
+
+   test_words = BITSET_WORDS(numtests);
+   version_words = BITSET_WORDS(numversions);
+   universe = (char **) realloc(fm->universe_lines, (numtests + 1) * sizeof(char *));
+   if (universe != NULL)
+      fm->universe_lines = universe;
+   matrix = bitset_alloc(BITS_PER_WORD * test_words * numversions);
+   matrix_by_test = bitset_alloc(BITS_PER_WORD * version_words * numtests);
+   changed = bitset_alloc(numtests);
+   if (universe == NULL || matrix == NULL || matrix_by_test == NULL || 
+       changed == NULL)
+   {
+      bitset_free(matrix);
+      bitset_free(matrix_by_test);
+      bitset_free(changed);
+      fprintf(stderr, "error: unable to malloc memory for matrix (%dx%d)\n",
+	      numtests, numversions);
+      return FALSE;
+   }
+
+   for (i = fm->numtests; i < numtests; i++)
+   {
+      universe[i] = strdup(lines[i - fm->numtests]);
+      if (universe[i] == NULL)
+      {
+	 fprintf(stderr, "error: unable to malloc memory for line %d of the universe\n", i);
+	 return FALSE;
+      }
+   }
+   universe[numtests] = NULL;
+
+   /* the rows keep their bits, with the stride of the new size */
+   for (i = 0; i < fm->numversions; i++)
+      bitset_copy(matrix + i * test_words, fm->matrix + i * fm->test_words, 
+		  fm->test_words);
+   for (i = 0; i < fm->numtests; i++)
+      bitset_copy(matrix_by_test + i * version_words, 
+		  fm->matrix_by_test + i * fm->version_words, fm->version_words);
+   if (fm->changed_tests != NULL)
+      bitset_copy(changed, fm->changed_tests, BITSET_WORDS(fm->numtests));
+
+   bitset_free(fm->matrix);
+   bitset_free(fm->matrix_by_test);
+   bitset_free(fm->changed_tests);
+   fm->matrix = matrix;
+   fm->matrix_by_test = matrix_by_test;
+   fm->changed_tests = changed;
+   fm->numtests = numtests;
+   fm->numversions = numversions;
+   fm->test_words = test_words;
+   fm->version_words = version_words;
+
+   if (! build_universe_index(fm))
+   {
+      fprintf(stderr, "error: unable to malloc memory for the index of %d universe lines\n",
+	      numtests);
+      return FALSE;
+   }
+
+   return TRUE;
+}
+
+int fm_set_exposed(fault_matrix *fm, int test, int version, int value)
+{
+   assert(test >= 0 && test < fm->numtests);
+   assert(version >= 1 && version <= fm->numversions);
+   assert(fm->mapped_matrix == NULL || fm->mapped_writable);
+
+   value = (value != 0);
+   if (fm_exposed(fm, test, version) == value)
+      return TRUE;
+
+   if (fm->changed_tests == NULL)
+   {
+      fm->changed_tests = bitset_alloc(fm->numtests);
+      if (fm->changed_tests == NULL)
+      {
+	 fprintf(stderr, "error: unable to malloc memory for %d tests\n", 
+		 fm->numtests);
+	 return FALSE;
+      }
+   }
+   BITSET_SET(fm->changed_tests, test);
+
+   if (value)
+   {
+      BITSET_SET(fm->matrix + (version - 1) * fm->test_words, test);
+      BITSET_SET(fm->matrix_by_test + test * fm->version_words, version - 1);
+   }
+   else
+   {
+      BITSET_CLEAR(fm->matrix + (version - 1) * fm->test_words, test);
+      BITSET_CLEAR(fm->matrix_by_test + test * fm->version_words, version - 1);
+   }
+
+   return TRUE;
+}
+
+/* writes again the blocks of a text matrix from the first one of a 
+   changed test on, the tests keep the order they have in the file */
+static int rewrite_text_tail(fault_matrix *fm, char *matrixfile)
+{
+   FILE *f;
+   char *line;
+   int *order;
+   long offset, start;
+   int i, j, test, first, ok;
+
+   f = fopen(matrixfile, "r+");
+   if (f == NULL)
+   {
+      fprintf(stderr, "error: unable to open %s for writing\n", matrixfile);
+      return FALSE;
+   }
+   line = (char *) malloc(INPUTMAX);
+   order = (int *) malloc((fm->numtests + 1) * sizeof(int));
+   ok = (line != NULL) && (order != NULL);
+
+   /* the two counts, then the universe lines */
+   for (i = 0; i < 2 && ok; i++)
+      ok = fgets(line, INPUTMAX, f) != NULL;
+   for (i = 0; i < fm->numtests && ok; )
+   {
+      ok = fgets(line, INPUTMAX, f) != NULL;
+      if (ok && ! skipped_universe_line(line))
+	 i++;
+   }
+
+   first = -1;
+   start = 0;
+   for (i = 0; i < fm->numtests && ok; i++)
+   {
+      offset = ftell(f);
+      ok = fgets(line, INPUTMAX, f) != NULL && 
+	 sscanf(line, "%*7s%d:", &test) == 1 && test >= 0 && test < fm->numtests;
+      if (! ok)
+	 break;
+      order[i] = test;
+      if (first < 0 && BITSET_TEST(fm->changed_tests, test))
+      {
+	 first = i;
+	 start = offset;
+      }
+      for (j = 0; j < 2 * fm->numversions && ok; j++)
+	 ok = fgets(line, INPUTMAX, f) != NULL;
+   }
+   if (! ok)
+   {
+      fprintf(stderr, "error: unable to read the blocks of %s\n", matrixfile);
+      fclose(f);
+      free(line);
+      free(order);
+      return FALSE;
+   }
+
+   if (first >= 0)
+   {
+      ok = fseek(f, start, SEEK_SET) == 0;
+      for (i = first; i < fm->numtests && ok; i++)
+	 write_test_block(fm, f, order[i]);
+      ok = ok && fflush(f) == 0 && ftruncate(fileno(f), ftell(f)) == 0;
+   }
+
+   free(line);
+   free(order);
+   if (fclose(f) != 0 || ! ok)
+   {
+      fprintf(stderr, "error: unable to write %s\n", matrixfile);
+      return FALSE;
+   }
+
+   return TRUE;
+}
+
+int fm_save(fault_matrix *fm, char *matrixfile)
+{
+   char *temp;
+   int ok, same_size;
+
+   same_size = (fm->numtests == fm->file_numtests && 
+		fm->numversions == fm->file_numversions);
+   if (same_size && fm->changed_tests == NULL)
+      return TRUE;
+
+   if (same_size && fm->mapped_writable)
+   {
+      ok = msync(fm->mapped_matrix, fm->mapped_length, MS_SYNC) == 0;
+      if (! ok)
+	 fprintf(stderr, "error: unable to write %s\n", matrixfile);
+   }
+   else if (same_size && ! is_binary_matrix(matrixfile))
+      ok = rewrite_text_tail(fm, matrixfile);
+   else
+   {
+      /* the matrix is written whole, under another name first */
+      temp = (char *) malloc(strlen(matrixfile) + 32);
+      if (temp == NULL)
+	 return FALSE;
+      sprintf(temp, "%s.%d.tmp", matrixfile, (int) getpid());
+      ok = (is_binary_matrix(matrixfile)) ? 
+	 fm_write_binary(fm, temp) : fm_write_text(fm, temp);
+      if (ok && rename(temp, matrixfile) != 0)
+      {
+	 fprintf(stderr, "error: unable to rename %s to %s\n", temp, matrixfile);
+	 ok = FALSE;
+      }
+      if (! ok)
+	 unlink(temp);
+      free(temp);
+   }
+
+   if (ok)
+   {
+      fm->file_numtests = fm->numtests;
+      fm->file_numversions = fm->numversions;
+      bitset_free(fm->changed_tests);
+      fm->changed_tests = NULL;
+   }
+
+   return ok;
+}
+
 /*----------------------------------------------------------------*/
 /* Internal Functions                                             */
 
@@ -167,10 +910,14 @@ int handle_error( int line_num, enum ERROR_TYPES error_type,
 		  FILE *file_handle, ... )
 {
     va_list argp;
-    char *error_string[15];
+    char *error_string[20];
 
     error_string[OPEN_FILE] = 
 	"unable to open fault matrix file: %s \n";
+    error_string[BINARY_MAP] = 
+	"unable to map fault matrix file: %s \n";
+    error_string[BINARY_FORMAT] = 
+	"corrupted binary fault matrix file: %s \n";
     error_string[NUM_VERS_A] = 
 	"unable to read first line (number of versions)\n";
     error_string[NUM_VERS_B] = 
@@ -179,24 +926,28 @@ int handle_error( int line_num, enum ERROR_TYPES error_type,
 	"unable to read second line (number of tests)\n";
     error_string[NUM_TESTS_B] = 
 	"unable to parse second line (number of tests)\n";
-    error_string[TOO_MANY] =
-        "too many (%d) tests in universe, increase MAXULINES constant (%d)\n";
     error_string[UNIVERSE_READ] =
 	"unable to read line %d of the universe\n";
     error_string[UNIVERSE_MALLOC] = 
 	"unable to malloc memory for line %d of the universe (%d chars)\n";
     error_string[MATRIX_MALLOC] = 
 	"unable to malloc memory for matrix (%dx%d)\n";
+    error_string[INDEX_MALLOC] = 
+	"unable to malloc memory for the index of %d universe lines\n";
     error_string[TEST_NUM_A] = 
 	"unable to read test number [%d tests read]\n";
     error_string[TEST_NUM_B] = 
 	"unable to parse test number [%d tests read]\n";
+    error_string[TEST_NUM_C] = 
+	"test number %d is out of range [0, %d)\n";
     error_string[VERS_NUM_A] = 
 	"unable to read version number for test #%d " 
 	"[%d tests, %d versions read]\n";
     error_string[VERS_NUM_B] = 
 	"unable to parse version number for test #%d "
 	"[%d tests, %d versions read]\n";
+    error_string[VERS_NUM_C] = 
+	"version number %d is out of range [1, %d]\n";
     error_string[FAULT_VAL_A] = 
 	"unable to read fault value for test #%d, fault #%d\n";
     error_string[FAULT_VAL_B] = 
@@ -217,54 +968,214 @@ int handle_error( int line_num, enum ERROR_TYPES error_type,
 /*----------------------------------------------------------------*/
 /* Access Functions                                               */
 
-int fault_exposed(int test, int version)
+int fm_exposed(fault_matrix *fm, int test, int version)
 {
-   return matrix[((version-1)*numtests) + test]; 
+   return BITSET_TEST(fm->matrix + (version - 1) * fm->test_words, test);
 }
 
-int number_of_tests()
+/* the set of tests exposing 'version', bit i is test i */
+const bitword *fm_exposing_tests(fault_matrix *fm, int version)
 {
-   return numtests;
+   assert(version >= 1 && version <= fm->numversions);
+   return fm->matrix + (version - 1) * fm->test_words;
 }
 
-int number_of_versions()
+/* the set of versions exposed by 'test', bit (v - 1) is version v */
+const bitword *fm_exposed_faults(fault_matrix *fm, int test)
 {
-   return numversions;
+   assert(test >= 0 && test < fm->numtests);
+   return fm->matrix_by_test + test * fm->version_words;
 }
 
-int testid_for_universe_line(char *uline)
+int fm_number_of_exposing_tests(fault_matrix *fm, int version)
 {
-   int i;
+   return bitset_count(fm_exposing_tests(fm, version), fm->test_words);
+}
+
+int fm_number_of_exposed_faults(fault_matrix *fm, int test)
+{
+   return bitset_count(fm_exposed_faults(fm, test), fm->version_words);
+}
+
+static int find_universe_line(fault_matrix *fm, const char *uline)
+{
+   int slot, mask;
+
+   if (fm->universe_index == NULL) return -1;
 
-   for (i=0;i<numtests;i++)
+   mask = fm->universe_index_size - 1;
+   slot = hash_line(uline) & mask;
+   while (fm->universe_index[slot] != 0)
    {
-      if (strcmp(uline,universe_lines[i]) == 0)
-         return(i);
-   } 
+      if (strcmp(uline, fm->universe_lines[fm->universe_index[slot] - 1]) == 0)
+	 return fm->universe_index[slot] - 1;
+      slot = (slot + 1) & mask;
+   }
+
+   return -1;
+}
+
+int fm_testid_for_universe_line(fault_matrix *fm, char *uline)
+{
+   int i;
+
+   i = find_universe_line(fm, uline);
+   if (i >= 0)
+      return(i);
+
    printf("Warning: uline %s not found in universe.\n",uline);
    return -1;
 }
 
-/* added */
+/* Looks up every line of 'file' in the universe.  Lines are compared
+   as testid_for_universe_line does, with their newline.  *ids is
+   malloced and holds the test number of each line, -1 where the line
+   is not in the universe; no warnings are printed.  Returns the number
+   of lines, -1 if the file cannot be read. */
+int fm_testids_for_universe_file(fault_matrix *fm, char *file, int **ids)
+{
+   FILE *f;
+   char *line;
+   int n, max_ids;
+   int *tmp;
 
-int fault_matrix_copy_universe_line(int testid, char * dest)
+   *ids = NULL;
+   f = fopen(file, "rt");
+   if (f == NULL)
+   {
+      fprintf(stderr, "error: unable to open %s\n", file);
+      return -1;
+   }
+
+   line = (char *) malloc(INPUTMAX);
+   max_ids = 1024;
+   *ids = (int *) malloc(max_ids * sizeof(int));
+   if (line == NULL || *ids == NULL)
+   {
+      fprintf(stderr, "error: unable to malloc memory for lines of %s\n", file);
+      fclose(f);
+      free(line);
+      free(*ids);
+      *ids = NULL;
+      return -1;
+   }
+
+   n = 0;
+   while (fgets(line, INPUTMAX, f) != NULL)
+   {
+      if (n >= max_ids)
+      {
+	 max_ids *= 2;
+	 tmp = (int *) realloc(*ids, max_ids * sizeof(int));
+	 if (tmp == NULL)
+	 {
+	    fprintf(stderr, "error: unable to malloc memory for lines of %s\n", file);
+	    fclose(f);
+	    free(line);
+	    free(*ids);
+	    *ids = NULL;
+	    return -1;
+	 }
+	 *ids = tmp;
+      }
+      (*ids)[n++] = find_universe_line(fm, line);
+   }
+
+   fclose(f);
+   free(line);
+
+   return n;
+}
+
+int fm_copy_universe_line(fault_matrix *fm, int testid, char * dest)
 {
   char * ptr = NULL;
   int n;
 
-  assert(testid < number_of_tests());
+  assert(testid < fm->numtests);
   assert(testid >= 0);
 
-  n = strlen(universe_lines[testid]);
-  ptr = strchr(universe_lines[testid], '\n');
+  n = strlen(fm->universe_lines[testid]);
+  ptr = strchr(fm->universe_lines[testid], '\n');
   if (ptr != NULL)
     n--;
 
   if (dest != NULL)
     {
-      strncpy(dest, universe_lines[testid], n);
+      strncpy(dest, fm->universe_lines[testid], n);
       dest[n] = 0;
     }
 
   return n;
 }
+
+/*----------------------------------------------------------------*/
+/* Access Functions of the default matrix                         */
+
+fault_matrix *default_fault_matrix()
+{
+   return &default_matrix;
+}
+
+int fault_exposed(int test, int version)
+{
+   return fm_exposed(&default_matrix, test, version);
+}
+
+const bitword *exposing_tests(int version)
+{
+   return fm_exposing_tests(&default_matrix, version);
+}
+
+const bitword *exposed_faults(int test)
+{
+   return fm_exposed_faults(&default_matrix, test);
+}
+
+int number_of_exposing_tests(int version)
+{
+   return fm_number_of_exposing_tests(&default_matrix, version);
+}
+
+int number_of_exposed_faults(int test)
+{
+   return fm_number_of_exposed_faults(&default_matrix, test);
+}
+
+/* number of words in the sets of tests and of versions */
+int test_set_words()
+{
+   return default_matrix.test_words;
+}
+
+int version_set_words()
+{
+   return default_matrix.version_words;
+}
+
+int number_of_tests()
+{
+   return default_matrix.numtests;
+}
+
+int number_of_versions()
+{
+   return default_matrix.numversions;
+}
+
+int testid_for_universe_line(char *uline)
+{
+   return fm_testid_for_universe_line(&default_matrix, uline);
+}
+
+int testids_for_universe_file(char *file, int **ids)
+{
+   return fm_testids_for_universe_file(&default_matrix, file, ids);
+}
+
+/* added */
+
+int fault_matrix_copy_universe_line(int testid, char * dest)
+{
+  return fm_copy_universe_line(&default_matrix, testid, dest);
+}
@@ -7,24 +7,86 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include "defs.h"
+#include "bitset.h"
 
 /*----------------------------------------------------------------*/
 
 /* global variables */
 
 enum ERROR_TYPES { 
-    OPEN_FILE, NUM_VERS_A, NUM_VERS_B, NUM_TESTS_A, NUM_TESTS_B, TOO_MANY, 
-    UNIVERSE_READ, UNIVERSE_MALLOC, MATRIX_MALLOC, TEST_NUM_A, TEST_NUM_B,
-    VERS_NUM_A, VERS_NUM_B, FAULT_VAL_A, FAULT_VAL_B
+    OPEN_FILE, BINARY_MAP, BINARY_FORMAT, NUM_VERS_A, NUM_VERS_B, NUM_TESTS_A, NUM_TESTS_B, 
+    UNIVERSE_READ, UNIVERSE_MALLOC, MATRIX_MALLOC, INDEX_MALLOC, TEST_NUM_A, TEST_NUM_B,
+    TEST_NUM_C, VERS_NUM_A, VERS_NUM_B, VERS_NUM_C, FAULT_VAL_A, FAULT_VAL_B
 };
 
+/* a fault matrix, kept in both directions with one bit per cell:
+   row (version - 1) of 'matrix' holds the tests exposing the version, 
+   row test of 'matrix_by_test' holds the versions it exposes, 
+   version v is bit (v - 1) */
+typedef struct
+{
+    int numtests, numversions;
+    char **universe_lines;
+    /* the CLASSPATH and setenv lines of the universe, which are not 
+       tests, with their newlines, NULL if none; they are written again 
+       before the universe lines */
+    char *skipped_lines;
+    int test_words, version_words;
+    bitword *matrix;
+    bitword *matrix_by_test;
+    /* open addressing index of universe_lines: the test number plus one, 
+       0 for empty slots, only the first of equal lines is indexed */
+    int *universe_index;
+    int universe_index_size;
+    /* the binary matrix file, NULL if the matrix was read from text, 
+       the map is shared when it is writable */
+    char *mapped_matrix;
+    size_t mapped_length;
+    int mapped_writable;
+    /* for updates: the tests changed since the matrix was read or 
+       saved, NULL if none, and the size of the matrix in its file */
+    bitword *changed_tests;
+    int file_numtests, file_numversions;
+} fault_matrix;
+
+void fm_init(fault_matrix *fm);
+void fm_free(fault_matrix *fm);
+int fm_read(fault_matrix *fm, char *matrixfile);
+int fm_write_binary(fault_matrix *fm, char *matrixfile);
+int fm_write_text(fault_matrix *fm, char *matrixfile);
+int fm_exposed(fault_matrix *fm, int test, int version);
+const bitword *fm_exposing_tests(fault_matrix *fm, int version);
+const bitword *fm_exposed_faults(fault_matrix *fm, int test);
+int fm_number_of_exposing_tests(fault_matrix *fm, int version);
+int fm_number_of_exposed_faults(fault_matrix *fm, int test);
+int fm_testid_for_universe_line(fault_matrix *fm, char *uline);
+int fm_testids_for_universe_file(fault_matrix *fm, char *file, int **ids);
+int fm_copy_universe_line(fault_matrix *fm, int testid, char * dest);
+int fm_read_update(fault_matrix *fm, char *matrixfile);
+int fm_resize(fault_matrix *fm, int numtests, int numversions, char **lines);
+int fm_set_exposed(fault_matrix *fm, int test, int version, int value);
+int fm_save(fault_matrix *fm, char *matrixfile);
+
+/* the functions below use the default matrix */
+fault_matrix *default_fault_matrix();
 int read_matrix(char *matrixfile);
+int write_matrix_binary(char *matrixfile);
+int write_matrix_text(char *matrixfile);
+int is_binary_matrix(char *matrixfile);
+int skipped_universe_line(char *line);
 int handle_error( int line_num, enum ERROR_TYPES error_type, 
 		  FILE *file_handle, ... );
 int fault_exposed(int test, int version);
+const bitword *exposing_tests(int version);
+const bitword *exposed_faults(int test);
+int number_of_exposing_tests(int version);
+int number_of_exposed_faults(int test);
+int test_set_words();
+int version_set_words();
 int number_of_tests();
 int number_of_versions();
 int testid_for_universe_line(char *uline);
+int testids_for_universe_file(char *file, int **ids);
 
 int fault_matrix_copy_universe_line(int testid, char * dest);
 
@@ -14,113 +14,251 @@
 #include "file_utils.h"
 #include "defs.h"
 
-int numfaults = -1, numversions = -1;
+/* the newVer file used by the functions without a context argument */
+static newver default_newver = {-1, -1, NULL, NULL, 0, NULL};
 
-int faults[MAXVERS][MAXFAULTS];
+#define FAULT(nv, version, fault) ((nv)->faults[(version) * ((nv)->numfaults + 1) + (fault)])
+#define FAULT_SET(nv, version) ((nv)->fault_sets + (version) * (nv)->fault_words)
 
 int get_line_size_v(char * file)
 {
-  int i;
-  char buff[MAXSTR];
-  FILE * f;
-
-  f = fopen(file, "rt");
-
-  if (f == NULL)
-    {
-      printf("Cannot open file %s for reading\n", file);
-      exit(-1);
-    }
-
-  assert(f != NULL);
+  return get_line_size(file);
+}
 
-  fgets(buff, MAXSTR, f);
+/* skips the next whitespace separated field of *s */
+static void skip_field(char * * s)
+{
+  *s += strspn(*s, " \t\r\n");
+  *s += strcspn(*s, " \t\r\n");
+}
 
-  if (strtok(buff, " \t") == NULL) 
-    i = 0;
-  else
-    i = 1;
+void nv_init(newver * nv)
+{
+  nv->numfaults = -1;
+  nv->numversions = -1;
+  nv->faults = NULL;
+  nv->fault_counts = NULL;
+  nv->fault_words = 0;
+  nv->fault_sets = NULL;
+}
 
-  while(strtok(NULL, " \t") != NULL) 
-    i++;
+void nv_free(newver * nv)
+{
+  free(nv->faults);
+  free(nv->fault_counts);
+  bitset_free(nv->fault_sets);
+  nv_init(nv);
+}
 
-  fclose(f);
+int nv_get_num_faults(newver * nv, int version)
+{
+  assert(version <= nv->numversions);
 
-  return i;
+  return nv->fault_counts[version];
 }
 
 int vers_get_num_faults(int version)
 {
-  int i, n;
-  n = 0;
-  for (i = 1; i <= numfaults; i++)
-    n += faults[version][i];
-  return n;
+  return nv_get_num_faults(&default_newver, version);
 }
 
 
-void load_faults(char * file)
+/* loads a newVer file into 'nv', the file loaded before is replaced */
+void nv_load(newver * nv, char * file)
 {
   int i, v;
-  FILE * f;
-  char buff[MAXSTR];
+  char * data, * s, * end;
+  size_t size;
 
-  numfaults = get_line_size_v(file) - 2;
+  nv_free(nv);
 
-  assert(numfaults > 0);
+  data = read_file_contents(file, &size);
 
-  numversions = getNumberLines(file);
-
-  f = fopen(file, "rt");
-
-  if (f == NULL)
+  if (data == NULL)
     {
       printf("Cannot open file %s for reading\n", file);
       exit(-1);
     }
 
-  assert(f != NULL);
+  nv->numfaults = count_fields(data) - 2;
+
+  assert(nv->numfaults > 0);
 
-  for (v = 1; v <= numversions; v++)
+  nv->numversions = count_newlines(data, size);
+
+  nv->faults = calloc((nv->numversions + 1) * (nv->numfaults + 1), sizeof(int));
+  if (nv->faults == NULL)
     {
-      fscanf(f, "%s", buff);
-      fscanf(f, "%s", buff);
-      for (i = 1 ; i <= numfaults; i++)
-	fscanf(f, "%i", &faults[v][i]);
+      printf("Cannot allocate memory for newVer file %s\n", file);
+      exit(-1);
     }
-  assert(numversions > 0);
+
+  /* each line is the version, its name and then the faults */
+  s = data;
+  for (v = 1; v <= nv->numversions; v++)
+    {
+      skip_field(&s);
+      skip_field(&s);
+      for (i = 1 ; i <= nv->numfaults; i++)
+	{
+	  FAULT(nv, v, i) = strtol(s, &end, 0);
+	  s = end;
+	}
+    }
+  assert(nv->numversions > 0);
  
-  fclose(f);
+  free(data);
 
-  printf("Loaded newVer file %s with %i faults\n", file, numversions);
+  /* the number and the set of faults of each version */
+  nv->fault_words = BITSET_WORDS(nv->numfaults);
+  nv->fault_counts = calloc(nv->numversions + 1, sizeof(int));
+  nv->fault_sets = bitset_alloc((nv->numversions + 1) * nv->fault_words * BITS_PER_WORD);
+  if ((nv->fault_counts == NULL) || (nv->fault_sets == NULL))
+    {
+      printf("Cannot allocate memory for newVer file %s\n", file);
+      exit(-1);
+    }
+  for (v = 1; v <= nv->numversions; v++)
+    for (i = 1 ; i <= nv->numfaults; i++)
+      if (FAULT(nv, v, i))
+	{
+	  nv->fault_counts[v]++;
+	  BITSET_SET(FAULT_SET(nv, v), i - 1);
+	}
 }
 
-void print_faults()
+void load_faults(char * file)
+{
+  nv_load(&default_newver, file);
+
+  printf("Loaded newVer file %s with %i faults\n", file, default_newver.numversions);
+}
+
+void nv_print(newver * nv)
 {
   int i, j, l;
-      for (i = 1 ; i <= numversions; i++)
+      for (i = 1 ; i <= nv->numversions; i++)
 	{
 	  l = 0;
-	  for (j = 1 ; j <= numfaults; j++)
-	    l += faults[i][j];
+	  for (j = 1 ; j <= nv->numfaults; j++)
+	    l += FAULT(nv, i, j);
 
 	  printf("Version=%i Faults=%i:   ", i, l);
-	  for (j = 1 ; j <= numfaults; j++)
-	    printf("%i  ", faults[i][j]);
+	  for (j = 1 ; j <= nv->numfaults; j++)
+	    printf("%i  ", FAULT(nv, i, j));
 	  printf("\n");
 	}
  
 }
 
-int fault_exposed_version(int version, int test, int fault)
+void print_faults()
+{
+  nv_print(&default_newver);
+}
+
+int nv_fault_exposed(newver * nv, fault_matrix * fm, int version, int test, int fault)
 {
   int n;
 
-  assert(version <= numversions);
-  assert(fault <= numfaults);
+  assert(version <= nv->numversions);
+  assert(fault <= nv->numfaults);
 
-  n = (fault_exposed(test, fault) && faults[version][fault]);
+  n = (fm_exposed(fm, test, fault) && FAULT(nv, version, fault));
   return n;
 }
 
+int fault_exposed_version(int version, int test, int fault)
+{
+  return nv_fault_exposed(&default_newver, default_fault_matrix(), version, test, fault);
+}
+
+/* whether 'fault' is seeded in 'version' */
+int nv_has_fault(newver * nv, int version, int fault)
+{
+  assert(version <= nv->numversions);
+  assert(fault <= nv->numfaults);
+
+  return FAULT(nv, version, fault);
+}
+
+int version_has_fault(int version, int fault)
+{
+  return nv_has_fault(&default_newver, version, fault);
+}
+
+/* the faults of 'version', bit (f - 1) is fault f */
+const bitword * nv_version_faults(newver * nv, int version)
+{
+  assert(version >= 1 && version <= nv->numversions);
+
+  return FAULT_SET(nv, version);
+}
+
+/* the faults of 'version' that 'test' exposes into 'faults', returns
+   their number */
+int nv_detected_faults(newver * nv, fault_matrix * fm, int version, int test, bitword * faults)
+{
+  int words;
+
+  words = (nv->fault_words < fm->version_words) ? nv->fault_words : fm->version_words;
+  bitset_zero(faults, fm->version_words);
+  bitset_copy(faults, nv_version_faults(nv, version), words);
+  bitset_and(faults, fm_exposed_faults(fm, test), fm->version_words);
+
+  return bitset_count(faults, fm->version_words);
+}
+
+/* whether 'test' exposes some fault of 'version' */
+int nv_version_detected(newver * nv, fault_matrix * fm, int version, int test)
+{
+  const bitword * faults, * exposed;
+  int i, words;
+
+  faults = nv_version_faults(nv, version);
+  exposed = fm_exposed_faults(fm, test);
+  words = (nv->fault_words < fm->version_words) ? nv->fault_words : fm->version_words;
+  for (i = 0; i < words; i++)
+    if ((faults[i] & exposed[i]) != 0)
+      return 1;
+
+  return 0;
+}
+
+/* the tests exposing some fault of 'version' into 'tests', the union
+   of the tests exposing each of its faults; returns their number */
+int nv_detecting_tests(newver * nv, fault_matrix * fm, int version, bitword * tests)
+{
+  const bitword * faults;
+  int f, n;
+
+  faults = nv_version_faults(nv, version);
+  n = (nv->numfaults < fm->numversions) ? nv->numfaults : fm->numversions;
+
+  bitset_zero(tests, fm->test_words);
+  for (f = bitset_next(faults, n, 0); f >= 0; f = bitset_next(faults, n, f + 1))
+    bitset_or(tests, fm_exposing_tests(fm, f + 1), fm->test_words);
+
+  return bitset_count(tests, fm->test_words);
+}
+
+const bitword * version_faults(int version)
+{
+  return nv_version_faults(&default_newver, version);
+}
+
+int detected_faults(int version, int test, bitword * faults)
+{
+  return nv_detected_faults(&default_newver, default_fault_matrix(), version, test, faults);
+}
+
+int version_detected(int version, int test)
+{
+  return nv_version_detected(&default_newver, default_fault_matrix(), version, test);
+}
+
+int detecting_tests(int version, bitword * tests)
+{
+  return nv_detecting_tests(&default_newver, default_fault_matrix(), version, tests);
+}
+
 #endif
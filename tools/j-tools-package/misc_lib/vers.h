@@ -12,10 +12,43 @@
 #include <string.h>
 #include "defs.h"
 
+/* the faults of every version in a newVer file, 
+   versions and faults are numbered from 1 */
+typedef struct
+{
+  int numfaults, numversions;
+  int * faults;
+  int * fault_counts;		/* number of faults of each version */
+  int fault_words;
+  bitword * fault_sets;		/* faults of each version, bit (f - 1) is fault f */
+} newver;
+
+void nv_init(newver * nv);
+void nv_free(newver * nv);
+void nv_load(newver * nv, char * file);
+void nv_print(newver * nv);
+int nv_get_num_faults(newver * nv, int version);
+int nv_fault_exposed(newver * nv, fault_matrix * fm, int version, int test, int fault);
+int nv_has_fault(newver * nv, int version, int fault);
 int get_line_size_v(char * file);
+
+/* bulk evaluation of the versions on a fault matrix: the sets are
+   those of fm, of fm->version_words and fm->test_words words, and
+   the faults of a version beyond those of fm are exposed by no test */
+const bitword * nv_version_faults(newver * nv, int version);
+int nv_detected_faults(newver * nv, fault_matrix * fm, int version, int test, bitword * faults);
+int nv_version_detected(newver * nv, fault_matrix * fm, int version, int test);
+int nv_detecting_tests(newver * nv, fault_matrix * fm, int version, bitword * tests);
+
+/* the functions below use the default newVer file */
 int vers_get_num_faults(int version);
 void load_faults(char * file);
 void print_faults();
 int fault_exposed_version(int version, int test, int fault);
+int version_has_fault(int version, int fault);
+const bitword * version_faults(int version);
+int detected_faults(int version, int test, bitword * faults);
+int version_detected(int version, int test);
+int detecting_tests(int version, bitword * tests);
 
 #endif